@@ -0,0 +1,272 @@
+#!/bin/bash
+
+# Linux - per-stage decode benchmark matrix: every libpng version in build/ times
+# {o3, asan, ubsan, asan-ubsan}. Each combination gets its own static zlib + libpng
+# build and a decode-bench binary (decode_bench.c + harness.c, same flags), run
+# over build/seeds and the PngSuite in pull mode (png_read_image) and push mode
+# (png_process_data). The report gives the cost of each stage, throughput and
+# decoder heap peak, and each sanitizer flavor relative to -O3 on the same version.
+#
+# usage: ./bench_decode.sh [options]
+#   -n N            passes over the corpus per combination (default: 100)
+#   -v "1.6.2 ..."  libpng versions (default: every one found in build/)
+#   -f "o3 asan"    flavors (default: o3 asan ubsan asan-ubsan)
+#   -m "pull push"  decode modes (default: pull push); push feeds HARNESS_FEED-byte
+#                   fragments, default 1460 (one TCP segment)
+#   -x "none gamma+bgr simplified"
+#                   also measure MB/s per transform combination (HARNESS_TRANSFORMS
+#                   syntax); "each" expands to none, every single transform and simplified
+#   -i DIR          corpus directory, repeatable (default: build/seeds + PngSuite)
+#   -o DIR          output directory (default: build/bench)
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${SCRIPT_DIR}/build"
+CC="${CC:-clang}"
+
+ITERATIONS=100
+VERSIONS=""
+FLAVORS="o3 asan ubsan asan-ubsan"
+MODES="pull push"
+XFORMS=""
+CORPUS=()
+BENCH_DIR="${BUILD_DIR}/bench"
+
+while getopts "n:v:f:m:x:i:o:" opt; do
+    case $opt in
+        n) ITERATIONS=$OPTARG ;;
+        v) VERSIONS=$OPTARG ;;
+        f) FLAVORS=$OPTARG ;;
+        m) MODES=$OPTARG ;;
+        x) XFORMS=$OPTARG ;;
+        i) CORPUS+=("$OPTARG") ;;
+        o) BENCH_DIR=$OPTARG ;;
+        *) sed -n '10,20p' "$0"; exit 1 ;;
+    esac
+done
+
+# build/libpng is the v1.6.43 checkout from build_linux.sh; the others are release tarballs
+libpng_source() {
+    if [ "$1" = "1.6.43" ]; then
+        echo "${BUILD_DIR}/libpng"
+    else
+        echo "${BUILD_DIR}/libpng-$1"
+    fi
+}
+
+if [ -z "${VERSIONS}" ]; then
+    for candidate in 1.6.2 1.6.15 1.6.43; do
+        if [ -x "$(libpng_source "$candidate")/configure" ]; then
+            VERSIONS="${VERSIONS} ${candidate}"
+        fi
+    done
+fi
+if [ -z "${VERSIONS}" ]; then
+    echo "ERROR: no libpng sources in ${BUILD_DIR}. Please run build_linux.sh or build_vulnerable.sh first."
+    exit 1
+fi
+
+ZLIB_SRC="${BUILD_DIR}/zlib"
+[ -d "${ZLIB_SRC}" ] || ZLIB_SRC="${BUILD_DIR}/zlib-1.3.1"
+if [ ! -d "${ZLIB_SRC}" ]; then
+    echo "ERROR: zlib source not found. Please run build_linux.sh first."
+    exit 1
+fi
+
+# sanitizer flavors use -O1 like the Part C libraries so the numbers match what
+# a sanitizer secondary actually runs
+flavor_cflags() {
+    case $1 in
+        o3) echo "-O3" ;;
+        asan) echo "-O1 -g -fno-omit-frame-pointer -fsanitize=address" ;;
+        ubsan) echo "-O1 -g -fno-omit-frame-pointer -fsanitize=undefined" ;;
+        asan-ubsan) echo "-O1 -g -fno-omit-frame-pointer -fsanitize=address,undefined" ;;
+        *) return 1 ;;
+    esac
+}
+
+# one corpus for the whole matrix so versions are comparable: the seeds plus
+# the newest PngSuite available, unless -i gave a real image mix
+if [ ${#CORPUS[@]} -eq 0 ]; then
+    CORPUS=("${BUILD_DIR}/seeds")
+    for candidate in ${VERSIONS}; do
+        if [ -d "$(libpng_source "$candidate")/contrib/pngsuite" ]; then
+            PNGSUITE="$(libpng_source "$candidate")/contrib/pngsuite"
+        fi
+    done
+    [ -n "${PNGSUITE}" ] && CORPUS+=("${PNGSUITE}")
+fi
+
+if [ "${XFORMS}" = "each" ]; then
+    XFORMS="none strip_16 gamma background alpha_mode quantize invert bgr interlace simplified"
+fi
+XFORM_ARGS=()
+for spec in ${XFORMS}; do
+    XFORM_ARGS+=(-x "${spec}")
+done
+
+export ASAN_OPTIONS="detect_leaks=0"
+export UBSAN_OPTIONS="print_stacktrace=0"
+export HARNESS_FEED="${HARNESS_FEED:-1460}"
+
+mkdir -p "${BENCH_DIR}"
+RESULTS="${BENCH_DIR}/results.csv"
+REPORT="${BENCH_DIR}/bench_report.md"
+# stages and decode_latency are in us, heap_peak in bytes, mb_per_s in MB/s
+echo "version,flavor,mode,metric,p50,p90,p99,mean" > "${RESULTS}"
+
+build_zlib() {
+    local flavor=$1 cflags=$2
+    local prefix="${BENCH_DIR}/zlib-${flavor}"
+    [ -f "${prefix}/lib/libz.a" ] && return 0
+    cd "${ZLIB_SRC}"
+    make distclean > /dev/null 2>&1 || make clean > /dev/null 2>&1 || rm -f Makefile || true
+    CC="${CC}" CFLAGS="${cflags}" ./configure --prefix="${prefix}" --static || return 1
+    make -j"$(nproc)" || return 1
+    make install || return 1
+}
+
+build_combo() {
+    local version=$1 flavor=$2 cflags=$3
+    local prefix="${BENCH_DIR}/libpng-${version}-${flavor}"
+    local zlib="${BENCH_DIR}/zlib-${flavor}"
+
+    build_zlib "$flavor" "$cflags" || return 1
+
+    if [ ! -f "${prefix}/lib/libpng16.a" ]; then
+        cd "$(libpng_source "$version")"
+        make distclean > /dev/null 2>&1 || make clean > /dev/null 2>&1 || rm -f Makefile || true
+        ./configure \
+            CC="${CC}" \
+            CFLAGS="${cflags}" \
+            LDFLAGS="${cflags}" \
+            CPPFLAGS="-I${zlib}/include" \
+            --prefix="${prefix}" \
+            --with-zlib-prefix="${zlib}" \
+            --disable-shared || return 1
+        make -j"$(nproc)" || return 1
+        make install || return 1
+    fi
+
+    # static libraries, so every binary is pinned to its own build
+    ${CC} ${cflags} \
+        -DHARNESS_NO_MAIN \
+        -DHARNESS_STAGE_HOOK \
+        -I"${prefix}/include" \
+        "${SCRIPT_DIR}/decode_bench.c" \
+        "${SCRIPT_DIR}/harness.c" \
+        "${prefix}/lib/libpng16.a" \
+        "${zlib}/lib/libz.a" \
+        -lm \
+        -o "${BENCH_DIR}/decode-bench-${version}-${flavor}" || return 1
+}
+
+echo "===== Decode Benchmark Matrix ====="
+echo "Versions: ${VERSIONS}"
+echo "Flavors:  ${FLAVORS}"
+echo "Modes:    ${MODES} (push fragments: ${HARNESS_FEED} bytes)"
+[ -n "${XFORMS}" ] && echo "Transforms: ${XFORMS}"
+echo "Corpus:   ${CORPUS[*]}"
+echo "Passes:   ${ITERATIONS}"
+
+for version in ${VERSIONS}; do
+    for flavor in ${FLAVORS}; do
+        cflags=$(flavor_cflags "$flavor") || { echo "unknown flavor ${flavor}"; exit 1; }
+        log="${BENCH_DIR}/build-${version}-${flavor}.log"
+        echo ""
+        echo "libpng ${version} / ${flavor}: building..."
+        if ! build_combo "$version" "$flavor" "$cflags" > "${log}" 2>&1; then
+            echo "  build failed, skipped (see ${log})"
+            continue
+        fi
+        for mode in ${MODES}; do
+            case $mode in
+                pull) mode_flag="" ;;
+                push) mode_flag="-p" ;;
+                *) echo "unknown mode ${mode}"; exit 1 ;;
+            esac
+            run="${BENCH_DIR}/run-${version}-${flavor}-${mode}"
+            echo "  ${mode}: running ${ITERATIONS} passes..."
+            "${BENCH_DIR}/decode-bench-${version}-${flavor}" -n "${ITERATIONS}" ${mode_flag} \
+                -l "${version},${flavor},${mode}" "${CORPUS[@]}" 2> "${run}.log" \
+                | tee "${run}.txt" | sed 's/^/    /'
+            "${BENCH_DIR}/decode-bench-${version}-${flavor}" -n "${ITERATIONS}" ${mode_flag} -c \
+                -l "${version},${flavor},${mode}" "${CORPUS[@]}" 2>> "${run}.log" \
+                >> "${RESULTS}"
+            [ ${#XFORM_ARGS[@]} -eq 0 ] && continue
+
+            echo "  ${mode}: transform matrix..."
+            "${BENCH_DIR}/decode-bench-${version}-${flavor}" -n "${ITERATIONS}" ${mode_flag} \
+                "${XFORM_ARGS[@]}" -l "${version},${flavor},${mode}" "${CORPUS[@]}" \
+                2>> "${run}.log" | tee "${run}-xform.txt" | sed 's/^/    /'
+            "${BENCH_DIR}/decode-bench-${version}-${flavor}" -n "${ITERATIONS}" ${mode_flag} -c \
+                "${XFORM_ARGS[@]}" -l "${version},${flavor},${mode}" "${CORPUS[@]}" \
+                2>> "${run}.log" >> "${RESULTS}"
+        done
+    done
+done
+
+# p50 microseconds per corpus pass, one row per combination
+{
+    echo "# Decode benchmark"
+    echo ""
+    echo "Corpus: ${CORPUS[*]}. ${ITERATIONS} passes per combination; times are p50 us per pass."
+    echo "Push mode feeds ${HARNESS_FEED}-byte fragments and re-encodes rows inside read_image;"
+    echo "it skips the re-encode of interlaced images, which would need the whole image."
+    echo "Overhead is total time relative to -O3 on the same libpng version and mode."
+    echo "Heap is the decoder's peak per decode (libpng + row buffers), p50 / p99 in KB;"
+    echo "n/a when png_image_* decoded, since it allocates outside the counting allocator."
+    echo ""
+    echo "| libpng | flavor | mode | read_info | transforms | read_image | read_end | encode | total | total p99 | MB/s | heap KB | overhead |"
+    echo "|--------|--------|------|----------:|-----------:|-----------:|---------:|-------:|------:|----------:|-----:|--------:|---------:|"
+    awk -F, 'NR > 1 {
+        key = $1 "," $2 "," $3
+        if (!(key in seen)) { seen[key] = 1; order[++n] = key }
+        p50[key, $4] = $5
+        p99[key, $4] = $7
+    }
+    END {
+        for (i = 1; i <= n; i++) {
+            split(order[i], k, ",")
+            base = p50[k[1] ",o3," k[3], "total"]
+            # no heap_peak row when the decodes went through png_image_*, which bypasses the counter
+            heap = ((order[i], "heap_peak") in p50) ?
+                sprintf("%.0f / %.0f", p50[order[i], "heap_peak"] / 1024, p99[order[i], "heap_peak"] / 1024) :
+                "n/a"
+            printf "| %s | %s | %s | %.0f | %.0f | %.0f | %.0f | %.0f | %.0f | %.0f | %.1f | %s | %s |\n",
+                k[1], k[2], k[3], p50[order[i], "read_info"], p50[order[i], "transforms"],
+                p50[order[i], "read_image"], p50[order[i], "read_end"], p50[order[i], "encode"],
+                p50[order[i], "total"], p99[order[i], "total"], p50[order[i], "mb_per_s"], heap,
+                (base > 0 ? sprintf("%.2fx", p50[order[i], "total"] / base) : "-")
+        }
+    }' "${RESULTS}"
+    echo ""
+
+    if [ -n "${XFORMS}" ]; then
+        echo "## Transform matrix"
+        echo ""
+        echo "MB/s of png input at the p50 pass, decode only (HARNESS_SINK=none). The first"
+        echo "spec is the baseline for each libpng / flavor / mode. simplified decodes"
+        echo "through png_image_finish_read; the other bits then pick its output format."
+        echo ""
+        echo "| libpng | flavor | mode | transforms | MB/s | vs ${XFORMS%% *} |"
+        echo "|--------|--------|------|------------|-----:|------:|"
+        awk -F, 'NR > 1 && $4 ~ /^xform:/ {
+            key = $1 "," $2 "," $3
+            if (!(key in base)) base[key] = $5
+            printf "| %s | %s | %s | %s | %.1f | %s |\n", $1, $2, $3, substr($4, 7), $5,
+                (base[key] > 0 ? sprintf("%.2fx", $5 / base[key]) : "-")
+        }' "${RESULTS}"
+        echo ""
+    fi
+
+    echo "An instance with overhead X executes roughly 1/X as many inputs per second as a"
+    echo "plain one, so N sanitizer secondaries cost about N * (1 - 1/X) plain instances."
+} > "${REPORT}"
+
+echo ""
+cat "${REPORT}"
+echo ""
+echo "Raw percentiles: ${RESULTS}"
+echo "Report written to ${REPORT}"
@@ -15,13 +15,71 @@ fi
 
 echo "Compiling png_mutator.c to shared library..."
 
+# crc32 comes from zlib; link the system libz since zlib-b is a non-PIC static archive
 gcc -shared -fPIC -O3 \
     -I"${AFLPLUSPLUS_DIR}/include" \
     "${SCRIPT_DIR}/png_mutator.c" \
+    -lz -lm \
     -o "${BUILD_DIR}/png_mutator.so"
 
+# The benchmark validates outputs with libpng 1.6.43, but libpng-b/zlib-b are
+# afl-instrumented since build_linux.sh compiles them with afl-clang-fast and
+# plain gcc cannot link them. It gets its own uninstrumented static copies
+PLAIN_ZLIB="${BUILD_DIR}/zlib-plain"
+PLAIN_LIBPNG="${BUILD_DIR}/libpng-plain"
+JOBS=$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
+
+if [ ! -f "${PLAIN_LIBPNG}/lib/libpng16.a" ]; then
+    if [ ! -d "${BUILD_DIR}/libpng" ] || [ ! -d "${BUILD_DIR}/zlib" ]; then
+        echo "ERROR: libpng/zlib sources not found. Please run build_linux.sh first."
+        exit 1
+    fi
+    echo "Building uninstrumented zlib and libpng for the benchmark..."
+
+    cd "${BUILD_DIR}/zlib"
+    make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
+    CC=gcc CFLAGS="-O3" ./configure --prefix="${PLAIN_ZLIB}" --static
+    make -j"${JOBS}"
+    make install
+
+    rm -rf "${PLAIN_LIBPNG}"
+    cd "${BUILD_DIR}/libpng"
+    make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
+    ./configure \
+        CC=gcc \
+        CFLAGS="-O3" \
+        CPPFLAGS="-I${PLAIN_ZLIB}/include" \
+        LDFLAGS="-L${PLAIN_ZLIB}/lib" \
+        --prefix="${PLAIN_LIBPNG}" \
+        --disable-shared
+    make -j"${JOBS}"
+    make install
+    cd "${SCRIPT_DIR}"
+fi
+
+echo "Compiling mutator microbenchmark..."
+
+gcc -O3 \
+    -I"${PLAIN_LIBPNG}/include" \
+    -L"${PLAIN_LIBPNG}/lib" \
+    -L"${PLAIN_ZLIB}/lib" \
+    "${SCRIPT_DIR}/mutator_bench.c" \
+    "${SCRIPT_DIR}/png_mutator.c" \
+    -lpng -lz -lm \
+    -o "${BUILD_DIR}/mutator-bench"
+
+echo "Compiling seed generator..."
+
+gcc -O3 \
+    "${SCRIPT_DIR}/png_seedgen.c" \
+    "${SCRIPT_DIR}/png_mutator.c" \
+    -lz -lm \
+    -o "${BUILD_DIR}/png-seedgen"
+
 echo ""
 echo "Custom mutator built successfully: ${BUILD_DIR}/png_mutator.so"
+echo "Benchmark: ${BUILD_DIR}/mutator-bench ${BUILD_DIR}/seeds [iterations] [validate_count]"
+echo "Seed generator: ${BUILD_DIR}/png-seedgen <out_dir> [count] [seed]"
 echo ""
 echo "To use with AFL++, set:"
 echo "  export AFL_CUSTOM_MUTATOR_LIBRARY=${BUILD_DIR}/png_mutator.so"
@@ -73,20 +73,25 @@ fi
 echo ""
 echo "Step 4: Building Part B - AFL++ without sanitizers"
 
-# Build zlib for Part B
+# Build zlib for Part B. Libraries go through afl-clang-fast too: with only the
+# harness instrumented afl sees ~50 edges and none of libpng's chunk handling
 cd "${ZLIB_DIR}"
 make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
-./configure --prefix="${BUILD_DIR}/zlib-b" --static
+CC="${AFL_CC}" ./configure --prefix="${BUILD_DIR}/zlib-b" --static
 make -j$(nproc)
 make install
 
-# Build LibPNG for Part B
+# Build LibPNG for Part B (static, so the harness cannot pick up a system libpng at runtime).
+# The prefix is cleared first: a libpng16.so from an older build would still win the link
+rm -rf "${BUILD_DIR}/libpng-b"
 cd "${LIBPNG_DIR}"
 make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
 ./configure \
+    CC="${AFL_CC}" \
     CFLAGS="-O3" \
     --prefix="${BUILD_DIR}/libpng-b" \
-    --with-zlib-prefix="${BUILD_DIR}/zlib-b"
+    --with-zlib-prefix="${BUILD_DIR}/zlib-b" \
+    --disable-shared
 make -j$(nproc)
 make install
 
@@ -97,11 +102,105 @@ echo "Building harness for Part B..."
     -L"${BUILD_DIR}/libpng-b/lib" \
     -L"${BUILD_DIR}/zlib-b/lib" \
     "${SCRIPT_DIR}/harness.c" \
-    -lpng -lz \
+    -lpng -lz -lm \
     -o "${BUILD_DIR}/harness-b"
 
 echo "Part B binary created: ${BUILD_DIR}/harness-b"
 
+# Persistent-mode variant: __AFL_LOOP over the shared-memory testcase, no file I/O
+echo "Building persistent harness for Part B..."
+"${AFLPLUSPLUS_DIR}/afl-clang-fast" -O3 \
+    -DHARNESS_PERSISTENT \
+    -I"${BUILD_DIR}/libpng-b/include" \
+    -L"${BUILD_DIR}/libpng-b/lib" \
+    -L"${BUILD_DIR}/zlib-b/lib" \
+    "${SCRIPT_DIR}/harness.c" \
+    -lpng -lz -lm \
+    -o "${BUILD_DIR}/harness-b-persistent"
+
+echo "Part B persistent binary created: ${BUILD_DIR}/harness-b-persistent"
+
+# Corpus distillation: harness.c instrumented like harness-b, driven in-process.
+# corpus_distill.c itself is compiled uninstrumented so its own loops stay out of the map
+echo "Building corpus distillation tool..."
+# with an uninstrumented libpng the map only holds harness.c edges and the cover keeps almost nothing
+if ! nm "${BUILD_DIR}/libpng-b/lib/libpng16.a" 2>/dev/null \
+        | grep -qE '__afl_area_ptr|__sanitizer_cov_trace_pc_guard'; then
+    echo "ERROR: ${BUILD_DIR}/libpng-b is not afl-instrumented; corpus-distill needs it"
+    exit 1
+fi
+clang -O2 -c "${SCRIPT_DIR}/corpus_distill.c" -o "${BUILD_DIR}/corpus_distill.o"
+"${AFLPLUSPLUS_DIR}/afl-clang-fast" -O3 \
+    -DHARNESS_NO_MAIN \
+    -I"${BUILD_DIR}/libpng-b/include" \
+    -L"${BUILD_DIR}/libpng-b/lib" \
+    -L"${BUILD_DIR}/zlib-b/lib" \
+    "${BUILD_DIR}/corpus_distill.o" \
+    "${SCRIPT_DIR}/harness.c" \
+    -lpng -lz -lm \
+    -o "${BUILD_DIR}/corpus-distill"
+
+echo "Corpus distillation binary created: ${BUILD_DIR}/corpus-distill"
+
+# ==================== Part 4b: CmpLog and laf-intel variants ====================
+# libpng gates nearly everything on 4-byte chunk names and the 8-byte signature,
+# which edge coverage alone only solves by brute force. A CmpLog build logs
+# comparison operands for afl-fuzz -c (input-to-state replacement); a laf-intel
+# build splits multi-byte compares into byte-sized ones so every matching byte
+# is a new edge. Both instrument zlib, libpng and the harness like Part B
+echo ""
+echo "Step 4b: Building CmpLog and laf-intel variants of Part B"
+
+build_variant() {
+    local name=$1
+
+    cd "${ZLIB_DIR}"
+    make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
+    CC="${AFL_CC}" ./configure --prefix="${BUILD_DIR}/zlib-${name}" --static
+    make -j$(nproc)
+    make install
+
+    cd "${LIBPNG_DIR}"
+    make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
+    ./configure \
+        CC="${AFL_CC}" \
+        CFLAGS="-O3" \
+        --prefix="${BUILD_DIR}/libpng-${name}" \
+        --with-zlib-prefix="${BUILD_DIR}/zlib-${name}" \
+        --disable-shared
+    make -j$(nproc)
+    make install
+
+    "${AFL_CC}" -O3 \
+        -I"${BUILD_DIR}/libpng-${name}/include" \
+        -L"${BUILD_DIR}/libpng-${name}/lib" \
+        -L"${BUILD_DIR}/zlib-${name}/lib" \
+        "${SCRIPT_DIR}/harness.c" \
+        -lpng -lz -lm \
+        -o "${BUILD_DIR}/harness-b-${name}"
+
+    "${AFL_CC}" -O3 \
+        -DHARNESS_PERSISTENT \
+        -I"${BUILD_DIR}/libpng-${name}/include" \
+        -L"${BUILD_DIR}/libpng-${name}/lib" \
+        -L"${BUILD_DIR}/zlib-${name}/lib" \
+        "${SCRIPT_DIR}/harness.c" \
+        -lpng -lz -lm \
+        -o "${BUILD_DIR}/harness-b-${name}-persistent"
+
+    echo "Part B ${name} binaries created: ${BUILD_DIR}/harness-b-${name}, ${BUILD_DIR}/harness-b-${name}-persistent"
+}
+
+# CmpLog binaries are only ever passed to -c, next to the matching harness-b build
+export AFL_LLVM_CMPLOG=1
+build_variant cmplog
+unset AFL_LLVM_CMPLOG
+
+# laf-intel binaries are fuzzing targets of their own
+export AFL_LLVM_LAF_ALL=1
+build_variant laf
+unset AFL_LLVM_LAF_ALL
+
 # ==================== Part 5: Build Configuration C (AFL++ with ASAN/UBSAN) ====================
 echo ""
 echo "Step 5: Building Part C - AFL++ with FULL ASAN and UBSAN (Linux)"
@@ -114,7 +213,10 @@ CC=clang CFLAGS="-fsanitize=address,undefined -fno-omit-frame-pointer -g" \
 make -j$(nproc)
 make install
 
-# Build LibPNG for Part C with sanitizers
+# Build LibPNG for Part C with sanitizers (static: harness-c-linux and crash-triage
+# must not resolve an unsanitized system libpng16.so at runtime). A shared library
+# left in the prefix by an older build would still win at link time
+rm -rf "${BUILD_DIR}/libpng-c"
 cd "${LIBPNG_DIR}"
 make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
 ./configure \
@@ -122,7 +224,8 @@ make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
     CFLAGS="-fsanitize=address,undefined -fno-omit-frame-pointer -g -O1" \
     LDFLAGS="-fsanitize=address,undefined" \
     --prefix="${BUILD_DIR}/libpng-c" \
-    --with-zlib-prefix="${BUILD_DIR}/zlib-c"
+    --with-zlib-prefix="${BUILD_DIR}/zlib-c" \
+    --disable-shared
 make -j$(nproc)
 make install
 
@@ -140,10 +243,42 @@ export AFL_USE_UBSAN=1
     "${SCRIPT_DIR}/harness.c" \
     -lpng -lz \
     -o "${BUILD_DIR}/harness-c-linux"
+
+echo "Building persistent harness for Part C with ASAN+UBSAN..."
+"${AFLPLUSPLUS_DIR}/afl-clang-fast" \
+    -fsanitize=address,undefined \
+    -fno-omit-frame-pointer \
+    -g -O1 \
+    -DHARNESS_PERSISTENT \
+    -I"${BUILD_DIR}/libpng-c/include" \
+    -L"${BUILD_DIR}/libpng-c/lib" \
+    -L"${BUILD_DIR}/zlib-c/lib" \
+    "${SCRIPT_DIR}/harness.c" \
+    -lpng -lz \
+    -o "${BUILD_DIR}/harness-c-persistent"
 unset AFL_USE_ASAN
 unset AFL_USE_UBSAN
 
 echo "Part C binary created: ${BUILD_DIR}/harness-c-linux (with ASAN+UBSAN)"
+echo "Part C persistent binary created: ${BUILD_DIR}/harness-c-persistent"
+
+# Crash triage: harness.c without main, replayed in-process by forked workers.
+# Plain clang: triage replays files, it needs no coverage instrumentation
+echo "Building crash triage tool with ASAN+UBSAN..."
+clang \
+    -fsanitize=address,undefined \
+    -fno-omit-frame-pointer \
+    -g -O1 \
+    -DHARNESS_NO_MAIN \
+    -I"${BUILD_DIR}/libpng-c/include" \
+    -L"${BUILD_DIR}/libpng-c/lib" \
+    -L"${BUILD_DIR}/zlib-c/lib" \
+    "${SCRIPT_DIR}/crash_triage.c" \
+    "${SCRIPT_DIR}/harness.c" \
+    -lpng -lz \
+    -o "${BUILD_DIR}/crash-triage"
+
+echo "Crash triage binary created: ${BUILD_DIR}/crash-triage"
 
 # Test the binary
 echo ""
@@ -166,6 +301,11 @@ echo ""
 echo "Binaries created:"
 echo "  Part B (AFL++ only):           ${BUILD_DIR}/harness-b"
 echo "  Part C (AFL++ + ASAN/UBSAN):   ${BUILD_DIR}/harness-c-linux"
+echo "  Persistent (no @@, shmem):     ${BUILD_DIR}/harness-b-persistent, ${BUILD_DIR}/harness-c-persistent"
+echo "  CmpLog (-c companions):        ${BUILD_DIR}/harness-b-cmplog, ${BUILD_DIR}/harness-b-cmplog-persistent"
+echo "  laf-intel (compare splitting): ${BUILD_DIR}/harness-b-laf, ${BUILD_DIR}/harness-b-laf-persistent"
+echo "  Crash triage (ASAN+UBSAN):     ${BUILD_DIR}/crash-triage (./triage_crashes.sh)"
+echo "  Corpus distillation:           ${BUILD_DIR}/corpus-distill (./distill_corpus.sh)"
 echo ""
 echo "Next steps:"
 echo "1. Download seeds: ./download_seeds.sh"
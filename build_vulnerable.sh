@@ -6,6 +6,15 @@ SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 BUILD_DIR="${SCRIPT_DIR}/build"
 ZLIB_DIR="${BUILD_DIR}/zlib-1.3.1"
 LIBPNG_VULN_DIR="${BUILD_DIR}/libpng-1.6.15"
+AFL_CC="${BUILD_DIR}/AFLplusplus/afl-clang-fast"
+
+# Part B libraries and harness are afl-instrumented when AFL++ is built;
+# without it the plain clang build below is all that is produced
+if [ -x "${AFL_CC}" ]; then
+    B_CC="${AFL_CC}"
+else
+    B_CC=clang
+fi
 
 echo "===== Building VULNERABLE LibPNG 1.6.15 for Better Fuzzing Results ====="
 echo ""
@@ -40,29 +49,71 @@ fi
 
 cd "${ZLIB_DIR}"
 make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
-./configure --prefix="${BUILD_DIR}/zlib-vuln-b" --static
+CC="${B_CC}" ./configure --prefix="${BUILD_DIR}/zlib-vuln-b" --static
 make -j$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
 make install
 
 cd "${LIBPNG_VULN_DIR}"
 make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
 ./configure \
+    CC="${B_CC}" \
     CFLAGS="-O3" \
     --prefix="${BUILD_DIR}/libpng-vuln-b" \
-    --with-zlib-prefix="${BUILD_DIR}/zlib-vuln-b"
+    --with-zlib-prefix="${BUILD_DIR}/zlib-vuln-b" \
+    --disable-shared
 make -j$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
 make install
 
 # Build harness for vulnerable version
 echo "Building harness with vulnerable LibPNG..."
-clang -O3 \
+"${B_CC}" -O3 \
     -I"${BUILD_DIR}/libpng-vuln-b/include" \
     -L"${BUILD_DIR}/libpng-vuln-b/lib" \
     -L"${BUILD_DIR}/zlib-vuln-b/lib" \
     "${SCRIPT_DIR}/harness.c" \
-    -lpng -lz \
+    -lpng -lz -lm \
     -o "${BUILD_DIR}/harness-vuln-b"
 
+# CmpLog (-c companion) and laf-intel (compare splitting) variants of Part B,
+# see build_linux.sh; they need afl-clang-fast
+build_variant() {
+    local name=$1
+
+    cd "${ZLIB_DIR}"
+    make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
+    CC="${AFL_CC}" ./configure --prefix="${BUILD_DIR}/zlib-vuln-${name}" --static
+    make -j$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
+    make install
+
+    cd "${LIBPNG_VULN_DIR}"
+    make distclean 2>/dev/null || make clean 2>/dev/null || rm -f Makefile || true
+    ./configure \
+        CC="${AFL_CC}" \
+        CFLAGS="-O3" \
+        --prefix="${BUILD_DIR}/libpng-vuln-${name}" \
+        --with-zlib-prefix="${BUILD_DIR}/zlib-vuln-${name}" \
+        --disable-shared
+    make -j$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
+    make install
+
+    "${AFL_CC}" -O3 \
+        -I"${BUILD_DIR}/libpng-vuln-${name}/include" \
+        -L"${BUILD_DIR}/libpng-vuln-${name}/lib" \
+        -L"${BUILD_DIR}/zlib-vuln-${name}/lib" \
+        "${SCRIPT_DIR}/harness.c" \
+        -lpng -lz -lm \
+        -o "${BUILD_DIR}/harness-vuln-b-${name}"
+}
+
+if [ -x "${AFL_CC}" ]; then
+    echo ""
+    echo "Building CmpLog and laf-intel variants of the vulnerable LibPNG..."
+    AFL_LLVM_CMPLOG=1 build_variant cmplog
+    AFL_LLVM_LAF_ALL=1 build_variant laf
+else
+    echo "AFL++ not built, skipping CmpLog and laf-intel variants"
+fi
+
 # Build vulnerable version for Part C (with sanitizers)
 echo ""
 echo "Building vulnerable LibPNG for Part C (with sanitizers)..."
@@ -100,6 +151,8 @@ echo "===== Build Complete ====="
 echo ""
 echo "Vulnerable binaries created:"
 echo "  ${BUILD_DIR}/harness-vuln-b (for Parts B.1 and B.2)"
+echo "  ${BUILD_DIR}/harness-vuln-b-cmplog (afl-fuzz -c companion of harness-vuln-b)"
+echo "  ${BUILD_DIR}/harness-vuln-b-laf (laf-intel compare splitting)"
 echo "  ${BUILD_DIR}/harness-vuln-c (for Part C with ASAN/UBSAN)"
 echo ""
 echo "Now run fuzzing with these vulnerable binaries!"
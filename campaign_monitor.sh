@@ -0,0 +1,247 @@
+#!/bin/bash
+
+# Linux - live telemetry for running AFL++ campaigns. Every interval it reads the
+# newest plot_data row and fuzzer_stats of each instance under the watched output
+# directories, samples the instance's process tree from /proc, and appends one
+# row per instance to a merged CSV and JSON-lines time series. Exec/s drops,
+# low stability, new crashes and dead instances are flagged as they happen.
+#
+# usage: ./campaign_monitor.sh [options] [output_dir...]
+#   -i SECONDS  sampling interval (default: 5, afl's plot_data period)
+#   -t SECONDS  stop after this long (default: run until interrupted)
+#   -d PERCENT  flag exec/s this far below the instance's running average (default: 50)
+#   -s PERCENT  flag stability below this (default: 90)
+#   -o DIR      where telemetry.csv/.jsonl and alerts.log go (default: build/telemetry)
+#   output_dir  afl -o directories to watch (default: build/output-*)
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${SCRIPT_DIR}/build"
+
+INTERVAL=5
+DURATION=0
+DROP_PCT=50
+MIN_STABILITY=90
+TELEMETRY_DIR="${BUILD_DIR}/telemetry"
+
+while getopts "i:t:d:s:o:" opt; do
+    case $opt in
+        i) INTERVAL=$OPTARG ;;
+        t) DURATION=$OPTARG ;;
+        d) DROP_PCT=$OPTARG ;;
+        s) MIN_STABILITY=$OPTARG ;;
+        o) TELEMETRY_DIR=$OPTARG ;;
+        *) sed -n '9,16p' "$0"; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+ROOTS=("$@")
+if [ ${#ROOTS[@]} -eq 0 ]; then
+    ROOTS=("${BUILD_DIR}"/output-*)
+fi
+
+# exec/s has to stay low for this many samples in a row before it is flagged;
+# the first samples of an instance only seed its average (calibration is slow)
+DROP_SAMPLES=3
+WARMUP_SAMPLES=3
+CLK_TCK=$(getconf CLK_TCK)
+
+mkdir -p "${TELEMETRY_DIR}"
+CSV="${TELEMETRY_DIR}/telemetry.csv"
+JSONL="${TELEMETRY_DIR}/telemetry.jsonl"
+ALERTS="${TELEMETRY_DIR}/alerts.log"
+if [ ! -f "${CSV}" ]; then
+    echo "time,config,instance,pid,run_time,execs_done,execs_per_sec,edges_found,corpus_count,stability,saved_crashes,saved_hangs,cpu_pct,rss_mb,ctx_vol_per_sec,ctx_invol_per_sec,alerts" > "${CSV}"
+fi
+touch "${JSONL}" "${ALERTS}"
+
+# per instance, keyed by its afl output dir
+declare -A PREV_TIME PREV_TICKS PREV_VOL PREV_INVOL AVG_EPS SAMPLES LOW_STREAK STABILITY_LOW LAST_CRASHES LAST_PID
+
+# "key value" pairs of fuzzer_stats, one per line
+stats_fields() {
+    awk -F' *: *' '{ print $1, $2 }' "$1" 2>/dev/null
+}
+
+# newest plot_data row, picked apart by the header's column names rather than
+# by position: the column set differs between afl++ versions
+plot_fields() {
+    { head -n 1 "$1"; tail -n 1 "$1"; } 2>/dev/null | awk -F', *' '
+        NR == 1 { sub(/^# */, ""); for (i = 1; i <= NF; i++) col[$i] = i; next }
+        NR == 2 && !/^#/ {
+            split("relative_time execs_per_sec total_execs edges_found corpus_count saved_crashes saved_hangs", keys, " ")
+            for (k = 1; k <= 7; k++)
+                if (keys[k] in col) print keys[k], $(col[keys[k]])
+        }'
+}
+
+# "cpu_ticks rss_kb voluntary involuntary" summed over afl-fuzz and its children:
+# the fork server (and in persistent mode the target itself) does the real work,
+# and short-lived non-persistent children land in the fork server's cutime
+proc_sample() {
+    local pid=$1 files=() child
+    for child in "$pid" $(ps -o pid= --ppid "$pid" 2>/dev/null); do
+        files+=("/proc/${child}/stat" "/proc/${child}/status")
+    done
+    awk '
+        FILENAME ~ /\/stat$/ { sub(/^.*\) /, ""); ticks += $12 + $13 + $14 + $15; next }
+        /^VmRSS:/ { rss += $2 }
+        /^voluntary_ctxt_switches:/ { vol += $2 }
+        /^nonvoluntary_ctxt_switches:/ { invol += $2 }
+        END { printf "%d %d %d %d\n", ticks, rss, vol, invol }
+    ' "${files[@]}" 2>/dev/null
+}
+
+alert() {
+    local line
+    line="$(date '+%Y-%m-%d %H:%M:%S') $1"
+    echo "ALERT ${line}"
+    echo "${line}" >> "${ALERTS}"
+}
+
+# label for an instance dir: output-campaign main, output-campaign/scale-4 sec1-asan, ...
+instance_label() {
+    local dir=$1 root=$2
+    local rel="${dir#"${root}"/}"
+    CONFIG="$(basename "${root}")"
+    if [ "${rel%/*}" != "${rel}" ]; then
+        CONFIG="${CONFIG}/${rel%/*}"
+    fi
+    INSTANCE="${rel##*/}"
+}
+
+sample_instance() {
+    local dir=$1 now=$2
+    local -A s=()
+    local key value
+    while read -r key value; do
+        s[$key]=$value
+    done < <(stats_fields "${dir}/fuzzer_stats"; plot_fields "${dir}/plot_data")
+
+    local pid=${s[fuzzer_pid]:-0}
+    local eps=${s[execs_per_sec]:-0}
+    local stability=${s[stability]:-100}
+    stability=${stability%\%}
+    local crashes=${s[saved_crashes]:-0}
+    local label="${CONFIG} ${INSTANCE}"
+    local alerts=()
+
+    # afl-fuzz leaves fuzzer_stats behind; only running instances are sampled
+    if [ "$pid" -eq 0 ] || ! kill -0 "$pid" 2>/dev/null; then
+        if [ -n "${LAST_PID[$dir]}" ]; then
+            alert "${label}: instance stopped (pid ${LAST_PID[$dir]})"
+            unset "LAST_PID[$dir]"
+        fi
+        return
+    fi
+    if [ "${LAST_PID[$dir]}" != "$pid" ]; then
+        # new or restarted instance: start its averages over
+        LAST_PID[$dir]=$pid
+        SAMPLES[$dir]=0
+        LOW_STREAK[$dir]=0
+        STABILITY_LOW[$dir]=0
+        AVG_EPS[$dir]=0
+        unset "PREV_TIME[$dir]"
+        LAST_CRASHES[$dir]=$crashes
+    fi
+
+    local ticks rss vol invol
+    read -r ticks rss vol invol <<< "$(proc_sample "$pid")"
+    local cpu_pct=0 vol_rate=0 invol_rate=0
+    if [ -n "${PREV_TIME[$dir]}" ]; then
+        read -r cpu_pct vol_rate invol_rate <<< "$(awk -v dt=$((now - PREV_TIME[$dir])) \
+            -v dticks=$((ticks - PREV_TICKS[$dir])) -v tck="${CLK_TCK}" \
+            -v dvol=$((vol - PREV_VOL[$dir])) -v dinvol=$((invol - PREV_INVOL[$dir])) '
+            BEGIN { if (dt < 1) dt = 1; printf "%.1f %.1f %.1f\n", 100 * dticks / tck / dt, dvol / dt, dinvol / dt }')"
+    fi
+    PREV_TIME[$dir]=$now
+    PREV_TICKS[$dir]=$ticks
+    PREV_VOL[$dir]=$vol
+    PREV_INVOL[$dir]=$invol
+
+    # exec/s against a slow running average of this instance, which still
+    # follows the gradual slowdown of a growing corpus
+    local verdict
+    verdict=$(awk -v eps="$eps" -v avg="${AVG_EPS[$dir]}" -v n="${SAMPLES[$dir]}" \
+        -v streak="${LOW_STREAK[$dir]}" -v drop="${DROP_PCT}" -v warm="${WARMUP_SAMPLES}" '
+        BEGIN {
+            low = (n >= warm && eps < avg * (1 - drop / 100))
+            if (low) streak++; else streak = 0
+            if (n < warm) avg = (avg * n + eps) / (n + 1)
+            else if (!low) avg = 0.9 * avg + 0.1 * eps
+            printf "%.2f %d %d\n", avg, streak, low
+        }')
+    local low
+    read -r "AVG_EPS[$dir]" "LOW_STREAK[$dir]" low <<< "${verdict}"
+    SAMPLES[$dir]=$((SAMPLES[$dir] + 1))
+
+    if [ "${LOW_STREAK[$dir]}" -eq "${DROP_SAMPLES}" ]; then
+        alerts+=("exec/s ${eps} is more than ${DROP_PCT}% below average ${AVG_EPS[$dir]}")
+    fi
+    # stability is flagged once when it falls below the threshold, not every sample
+    if awk -v s="$stability" -v min="${MIN_STABILITY}" 'BEGIN { exit !(s < min) }'; then
+        if [ "${STABILITY_LOW[$dir]}" -eq 0 ]; then
+            alerts+=("stability ${stability}% below ${MIN_STABILITY}%")
+        fi
+        STABILITY_LOW[$dir]=1
+    else
+        STABILITY_LOW[$dir]=0
+    fi
+    if [ "$crashes" -gt "${LAST_CRASHES[$dir]:-0}" ]; then
+        alerts+=("$((crashes - LAST_CRASHES[$dir])) new crash(es), ${crashes} total")
+        LAST_CRASHES[$dir]=$crashes
+    fi
+
+    local message
+    for message in "${alerts[@]}"; do
+        alert "${label}: ${message}"
+    done
+
+    local joined
+    joined=$(printf '%s; ' "${alerts[@]}")
+    joined=${joined%; }
+    local stamp
+    stamp=$(date -u -d "@${now}" '+%Y-%m-%dT%H:%M:%SZ')
+    local rss_mb=$((rss / 1024))
+    local run_time=${s[relative_time]:-${s[run_time]:-0}}
+    local execs=${s[total_execs]:-${s[execs_done]:-0}}
+
+    echo "${stamp},${CONFIG},${INSTANCE},${pid},${run_time},${execs},${eps},${s[edges_found]:-0},${s[corpus_count]:-0},${stability},${crashes},${s[saved_hangs]:-0},${cpu_pct},${rss_mb},${vol_rate},${invol_rate},\"${joined}\"" >> "${CSV}"
+    printf '{"time":"%s","config":"%s","instance":"%s","pid":%d,"run_time":%d,"execs_done":%d,"execs_per_sec":%s,"edges_found":%d,"corpus_count":%d,"stability":%s,"saved_crashes":%d,"saved_hangs":%d,"cpu_pct":%s,"rss_mb":%d,"ctx_vol_per_sec":%s,"ctx_invol_per_sec":%s,"alerts":"%s"}\n' \
+        "${stamp}" "${CONFIG}" "${INSTANCE}" "${pid}" "${run_time}" "${execs}" "${eps}" \
+        "${s[edges_found]:-0}" "${s[corpus_count]:-0}" "${stability}" "${crashes}" \
+        "${s[saved_hangs]:-0}" "${cpu_pct}" "${rss_mb}" "${vol_rate}" "${invol_rate}" "${joined}" >> "${JSONL}"
+
+    TICK_EPS=$(awk -v a="${TICK_EPS}" -v b="$eps" 'BEGIN { printf "%.0f", a + b }')
+    TICK_RUNNING=$((TICK_RUNNING + 1))
+}
+
+trap 'echo ""; echo "Telemetry written to ${TELEMETRY_DIR}"; exit 0' INT TERM
+
+echo "===== Campaign Telemetry ====="
+echo "Watching: ${ROOTS[*]}"
+echo "Writing:  ${CSV}, ${JSONL}"
+echo "Alerts:   exec/s ${DROP_PCT}% below average, stability < ${MIN_STABILITY}%, new crashes, stopped instances"
+echo ""
+
+START=$(date +%s)
+while [ "${DURATION}" -eq 0 ] || [ $(( $(date +%s) - START )) -lt "${DURATION}" ]; do
+    NOW=$(date +%s)
+    TICK_EPS=0
+    TICK_RUNNING=0
+    for root in "${ROOTS[@]}"; do
+        [ -d "$root" ] || continue
+        while IFS= read -r stats; do
+            dir=$(dirname "$stats")
+            instance_label "$dir" "$root"
+            sample_instance "$dir" "$NOW"
+        done < <(find "$root" -maxdepth 3 -name fuzzer_stats 2>/dev/null | sort)
+    done
+    echo "$(date '+%H:%M:%S') ${TICK_RUNNING} instance(s) running, ${TICK_EPS} exec/s total"
+    sleep "${INTERVAL}"
+done
+
+echo ""
+echo "Telemetry written to ${TELEMETRY_DIR}"
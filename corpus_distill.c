@@ -0,0 +1,568 @@
+// merges afl queues into one compact seed set: every input is decoded in-process
+// by forked workers (one per core) running LLVMFuzzerTestOneInput, its afl
+// coverage map is read straight out of __afl_area_ptr, and a greedy set cover
+// keeps the fewest inputs that still hit every (edge, hit-count bucket) pair
+// the whole merged corpus hits, the same tuples afl-cmin preserves
+// usage: corpus-distill [-j jobs] [-t timeout_ms] [-o out_dir] <dir|file>...
+// -o writes the kept inputs to out_dir/cover; without it only the coverage is reported
+// build: harness.c with -DHARNESS_NO_MAIN and afl-clang-fast against libpng-b
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// afl-compiler-rt: without __AFL_SHM_ID the map is a private buffer of __afl_map_size bytes
+extern uint8_t *__afl_area_ptr;
+extern uint32_t __afl_map_size;
+
+#define MAX_WORKERS 256
+// afl-fuzz does not queue anything larger
+#define MAX_INPUT_SIZE (1024 * 1024)
+
+enum { INPUT_PENDING, INPUT_OK, INPUT_CRASH, INPUT_HANG, INPUT_DUPLICATE };
+
+typedef struct {
+    char *path;
+    off_t size;
+    uint64_t hash;
+    int status;
+    uint32_t *tuples;   // (edge << 3) | hit-count bucket, ascending
+    uint32_t tuple_count;
+    uint32_t gain;      // upper bound on new tuples, refreshed lazily
+    int selected;
+} input_t;
+
+typedef struct {
+    pid_t pid;
+    int cmd_fd;         // parent -> worker: input indices
+    int result_fd;      // worker -> parent: tuple count then tuples, EOF when it dies
+    int current;        // input being decoded, -1 if idle
+    double deadline;
+} worker_t;
+
+static input_t *inputs;
+static int input_count, input_capacity;
+static worker_t workers[MAX_WORKERS];
+static int worker_count;
+static int timeout_ms = 1000;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint8_t *load(const char *path, off_t size) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    uint8_t *data = (uint8_t *)malloc(size > 0 ? size : 1);
+    if (data && fread(data, 1, size, fp) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+static uint64_t fnv1a(const uint8_t *data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// instances of one campaign sync each other's finds, so most of a merged
+// queue is byte-identical copies; those are dropped before anything runs
+static void add_input(const char *path, off_t size) {
+    if (size > MAX_INPUT_SIZE) return;
+    uint8_t *data = load(path, size);
+    if (!data) return;
+    uint64_t hash = fnv1a(data, size);
+    free(data);
+
+    if (input_count == input_capacity) {
+        input_capacity = input_capacity ? input_capacity * 2 : 1024;
+        inputs = (input_t *)realloc(inputs, input_capacity * sizeof(input_t));
+        if (!inputs) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    input_t *input = &inputs[input_count++];
+    memset(input, 0, sizeof(*input));
+    input->path = strdup(path);
+    input->size = size;
+    input->hash = hash;
+    input->status = INPUT_PENDING;
+}
+
+// a file, or every regular file in a directory except afl's README.txt;
+// queue/.state and other dot entries are skipped
+static void collect(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return;
+    }
+    if (S_ISREG(st.st_mode)) {
+        add_input(path, st.st_size);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.' || !strcmp(entry->d_name, "README.txt")) continue;
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        if (stat(file, &st) == 0 && S_ISREG(st.st_mode))
+            add_input(file, st.st_size);
+    }
+    closedir(dir);
+}
+
+static int by_hash(const void *a, const void *b) {
+    const input_t *x = (const input_t *)a, *y = (const input_t *)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+static void mark_duplicates(void) {
+    if (input_count > 1)
+        qsort(inputs, input_count, sizeof(input_t), by_hash);
+    for (int i = 1; i < input_count; i++)
+        if (inputs[i].hash == inputs[i - 1].hash && inputs[i].size == inputs[i - 1].size)
+            inputs[i].status = INPUT_DUPLICATE;
+}
+
+static int read_full(int fd, void *buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, (char *)buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        done += n;
+    }
+    return 1;
+}
+
+static int write_full(int fd, const void *buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, (const char *)buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        done += n;
+    }
+    return 1;
+}
+
+// afl's hit-count classes: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+
+static uint32_t count_bucket(uint8_t count) {
+    if (count <= 3) return count - 1;
+    if (count <= 7) return 3;
+    if (count <= 15) return 4;
+    if (count <= 31) return 5;
+    if (count <= 127) return 6;
+    return 7;
+}
+
+static void worker_main(int cmd_fd, int result_fd) {
+    uint32_t *tuples = (uint32_t *)malloc((__afl_map_size + 1) * sizeof(uint32_t));
+    if (!tuples) _exit(1);
+
+    // one-time setup inside libpng and zlib would otherwise be credited to
+    // whichever input each fresh worker decodes first
+    int index, warm = 0;
+    while (read_full(cmd_fd, &index, sizeof(index))) {
+        uint8_t *data = load(inputs[index].path, inputs[index].size);
+        if (data && !warm++)
+            LLVMFuzzerTestOneInput(data, inputs[index].size);
+        memset(__afl_area_ptr, 0, __afl_map_size);
+        if (data)
+            LLVMFuzzerTestOneInput(data, inputs[index].size);
+        free(data);
+
+        // slot 0 is afl's "target ran" marker, not an edge
+        uint32_t count = 0;
+        for (uint32_t edge = 1; edge < __afl_map_size; edge++)
+            if (__afl_area_ptr[edge])
+                tuples[1 + count++] = (edge << 3) | count_bucket(__afl_area_ptr[edge]);
+        tuples[0] = count;
+        if (!write_full(result_fd, tuples, (count + 1) * sizeof(uint32_t))) break;
+    }
+    _exit(0);
+}
+
+static void spawn(worker_t *w) {
+    int cmd[2], result[2];
+    if (pipe(cmd) != 0 || pipe(result) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(cmd[1]);
+        close(result[0]);
+        for (int i = 0; i < worker_count; i++) {
+            if (workers[i].pid > 0) {
+                close(workers[i].cmd_fd);
+                close(workers[i].result_fd);
+            }
+        }
+        // libpng warnings for thousands of inputs are noise here
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, 1);
+            dup2(devnull, 2);
+        }
+        worker_main(cmd[0], result[1]);
+    }
+
+    close(cmd[0]);
+    close(result[1]);
+    w->pid = pid;
+    w->cmd_fd = cmd[1];
+    w->result_fd = result[0];
+    w->current = -1;
+}
+
+static void dispatch(worker_t *w, int index) {
+    w->current = index;
+    w->deadline = now_ms() + timeout_ms;
+    if (write(w->cmd_fd, &index, sizeof(index)) != sizeof(index)) {
+        // worker already gone; the poll loop sees EOF on its result pipe
+    }
+}
+
+// a dead worker's input crashed or hung; it has no usable coverage and is dropped
+static void reap(worker_t *w, int status) {
+    close(w->cmd_fd);
+    close(w->result_fd);
+    if (w->pid > 0)
+        kill(w->pid, SIGKILL);
+    waitpid(w->pid, NULL, 0);
+    w->pid = 0;
+    if (w->current >= 0)
+        inputs[w->current].status = status;
+    w->current = -1;
+}
+
+static int receive(worker_t *w) {
+    input_t *input = &inputs[w->current];
+    uint32_t count;
+    if (!read_full(w->result_fd, &count, sizeof(count))) return 0;
+    input->tuples = (uint32_t *)malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!input->tuples) {
+        perror("malloc");
+        exit(1);
+    }
+    if (!read_full(w->result_fd, input->tuples, count * sizeof(uint32_t))) return 0;
+    input->tuple_count = count;
+    input->status = INPUT_OK;
+    w->current = -1;
+    return 1;
+}
+
+static void run_workers(void) {
+    int next = 0;
+    struct pollfd fds[MAX_WORKERS];
+
+    for (;;) {
+        while (next < input_count && inputs[next].status != INPUT_PENDING)
+            next++;
+
+        int busy = 0;
+        double wake = now_ms() + 1000;
+        for (int i = 0; i < worker_count; i++) {
+            worker_t *w = &workers[i];
+            if (w->current < 0 && next < input_count) {
+                if (w->pid <= 0) spawn(w);
+                dispatch(w, next++);
+                while (next < input_count && inputs[next].status != INPUT_PENDING)
+                    next++;
+            }
+            fds[i].fd = w->current >= 0 ? w->result_fd : -1;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+            if (w->current >= 0) {
+                busy++;
+                if (w->deadline < wake) wake = w->deadline;
+            }
+        }
+        if (!busy) break;
+
+        int wait = (int)(wake - now_ms());
+        if (poll(fds, worker_count, wait > 0 ? wait : 0) < 0 && errno != EINTR) {
+            perror("poll");
+            exit(1);
+        }
+
+        double now = now_ms();
+        for (int i = 0; i < worker_count; i++) {
+            worker_t *w = &workers[i];
+            if (w->current < 0) continue;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (!receive(w))
+                    reap(w, INPUT_CRASH);
+            } else if (now >= w->deadline) {
+                reap(w, INPUT_HANG);
+            }
+        }
+    }
+
+    for (int i = 0; i < worker_count; i++)
+        if (workers[i].pid > 0)
+            reap(&workers[i], INPUT_OK);
+}
+
+static uint32_t tuple_limit(void) {
+    uint32_t limit = 0;
+    for (int i = 0; i < input_count; i++)
+        if (inputs[i].status == INPUT_OK && inputs[i].tuple_count)
+            if (inputs[i].tuples[inputs[i].tuple_count - 1] >= limit)
+                limit = inputs[i].tuples[inputs[i].tuple_count - 1] + 1;
+    return limit;
+}
+
+static uint32_t new_tuples(const input_t *input, const uint8_t *covered) {
+    uint32_t gain = 0;
+    for (uint32_t i = 0; i < input->tuple_count; i++)
+        gain += !covered[input->tuples[i]];
+    return gain;
+}
+
+// more new tuples first, then the smaller file
+static int better(const input_t *a, const input_t *b) {
+    if (a->gain != b->gain) return a->gain > b->gain;
+    return a->size < b->size;
+}
+
+static void sift_down(int *heap, int heap_size, int at) {
+    for (;;) {
+        int best = at, left = 2 * at + 1, right = left + 1;
+        if (left < heap_size && better(&inputs[heap[left]], &inputs[heap[best]])) best = left;
+        if (right < heap_size && better(&inputs[heap[right]], &inputs[heap[best]])) best = right;
+        if (best == at) return;
+        int tmp = heap[at];
+        heap[at] = heap[best];
+        heap[best] = tmp;
+        at = best;
+    }
+}
+
+// greedy set cover with lazy gains: a gain only ever shrinks, so the heap top
+// is taken as soon as its refreshed gain still beats the next entry. the
+// greedy order can leave early picks fully covered by later ones, so a second
+// pass drops every selected input none of whose tuples it covers alone
+static int select_cover(uint32_t *universe) {
+    uint32_t limit = tuple_limit();
+    uint8_t *covered = (uint8_t *)calloc(limit ? limit : 1, 1);
+    int *heap = (int *)malloc((input_count ? input_count : 1) * sizeof(int));
+    int *order = (int *)malloc((input_count ? input_count : 1) * sizeof(int));
+    if (!covered || !heap || !order) {
+        perror("malloc");
+        exit(1);
+    }
+
+    int heap_size = 0;
+    for (int i = 0; i < input_count; i++) {
+        if (inputs[i].status != INPUT_OK || !inputs[i].tuple_count) continue;
+        inputs[i].gain = inputs[i].tuple_count;
+        heap[heap_size++] = i;
+    }
+    for (int i = heap_size / 2 - 1; i >= 0; i--)
+        sift_down(heap, heap_size, i);
+
+    int picked = 0;
+    *universe = 0;
+    while (heap_size > 0) {
+        input_t *top = &inputs[heap[0]];
+        top->gain = new_tuples(top, covered);
+        if (top->gain == 0) {
+            heap[0] = heap[--heap_size];
+            sift_down(heap, heap_size, 0);
+            continue;
+        }
+        sift_down(heap, heap_size, 0);
+        if (&inputs[heap[0]] != top) continue;
+
+        top->selected = 1;
+        order[picked++] = heap[0];
+        for (uint32_t i = 0; i < top->tuple_count; i++)
+            covered[top->tuples[i]] = 1;
+        *universe += top->gain;
+        heap[0] = heap[--heap_size];
+        sift_down(heap, heap_size, 0);
+    }
+
+    // covered[] now counts how many selected inputs hit each tuple (capped)
+    memset(covered, 0, limit ? limit : 1);
+    for (int p = 0; p < picked; p++) {
+        input_t *input = &inputs[order[p]];
+        for (uint32_t i = 0; i < input->tuple_count; i++)
+            if (covered[input->tuples[i]] < 255) covered[input->tuples[i]]++;
+    }
+    int kept = picked;
+    for (int p = 0; p < picked; p++) {
+        input_t *input = &inputs[order[p]];
+        uint32_t i;
+        for (i = 0; i < input->tuple_count; i++)
+            if (covered[input->tuples[i]] < 2) break;
+        if (i < input->tuple_count) continue;
+        for (i = 0; i < input->tuple_count; i++)
+            covered[input->tuples[i]]--;
+        input->selected = 0;
+        kept--;
+    }
+
+    free(order);
+    free(heap);
+    free(covered);
+    return kept;
+}
+
+static int copy_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    FILE *out = in ? fopen(to, "wb") : NULL;
+    char buf[65536];
+    size_t n;
+    int ok = in && out;
+    while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+        ok = fwrite(buf, 1, n, out) == n;
+    if (out && fclose(out) != 0) ok = 0;
+    if (in) fclose(in);
+    return ok;
+}
+
+// out_dir/cover/ holds one file per kept input, ready for afl-fuzz -i;
+// out_dir/manifest.tsv maps each back to the queue entry it came from
+static void write_selection(const char *out_dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/cover", out_dir);
+    if ((mkdir(out_dir, 0755) != 0 && errno != EEXIST) ||
+        (mkdir(path, 0755) != 0 && errno != EEXIST)) {
+        perror(path);
+        exit(1);
+    }
+    snprintf(path, sizeof(path), "%s/manifest.tsv", out_dir);
+    FILE *manifest = fopen(path, "w");
+    if (!manifest) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(manifest, "file\tsize\ttuples\tsource\n");
+
+    int n = 0;
+    for (int i = 0; i < input_count; i++) {
+        if (!inputs[i].selected) continue;
+        char name[64];
+        snprintf(name, sizeof(name), "seed_%06d", n++);
+        snprintf(path, sizeof(path), "%s/cover/%s", out_dir, name);
+        if (!copy_file(inputs[i].path, path)) {
+            perror(path);
+            exit(1);
+        }
+        fprintf(manifest, "%s\t%ld\t%u\t%s\n", name, (long)inputs[i].size,
+                inputs[i].tuple_count, inputs[i].path);
+    }
+    fclose(manifest);
+}
+
+int main(int argc, char **argv) {
+    const char *out_dir = NULL;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "j:t:o:")) != -1) {
+        switch (opt) {
+        case 'j': jobs = atol(optarg); break;
+        case 't': timeout_ms = atoi(optarg); break;
+        case 'o': out_dir = optarg; break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-j jobs] [-t timeout_ms] [-o out_dir] <dir|file>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++)
+        collect(argv[i]);
+    if (input_count == 0) {
+        fprintf(stderr, "no inputs\n");
+        return 1;
+    }
+    mark_duplicates();
+
+    worker_count = jobs < 1 ? 1 : jobs > MAX_WORKERS ? MAX_WORKERS : jobs;
+    if (worker_count > input_count) worker_count = input_count;
+    for (int i = 0; i < worker_count; i++)
+        workers[i].current = -1;
+
+    // re-encode into memory rather than to disk, as the persistent harness does
+    setenv("HARNESS_SINK", "mem", 0);
+    LLVMFuzzerInitialize(&argc, &argv);
+    signal(SIGPIPE, SIG_IGN);
+
+    double start = now_ms();
+    run_workers();
+    double elapsed = now_ms() - start;
+
+    int counts[INPUT_DUPLICATE + 1] = { 0 };
+    off_t bytes_in = 0, bytes_out = 0;
+    for (int i = 0; i < input_count; i++) {
+        counts[inputs[i].status]++;
+        if (inputs[i].status != INPUT_DUPLICATE) bytes_in += inputs[i].size;
+    }
+
+    uint32_t universe;
+    int kept = select_cover(&universe);
+    for (int i = 0; i < input_count; i++)
+        if (inputs[i].selected) bytes_out += inputs[i].size;
+    if (out_dir)
+        write_selection(out_dir);
+
+    int unique = input_count - counts[INPUT_DUPLICATE];
+    printf("inputs:      %d (%d duplicates dropped)\n", input_count, counts[INPUT_DUPLICATE]);
+    printf("decoded:     %d in %.1fs on %d workers (%.0f inputs/s)\n", unique,
+           elapsed / 1e3, worker_count, unique / (elapsed > 0 ? elapsed / 1e3 : 1));
+    printf("crashes:     %d, hangs: %d (dropped)\n", counts[INPUT_CRASH], counts[INPUT_HANG]);
+    printf("tuples:      %u\n", universe);
+    printf("cover:       %d inputs, %ld bytes (from %d inputs, %ld bytes)\n", kept,
+           (long)bytes_out, counts[INPUT_OK], (long)bytes_in);
+    if (out_dir)
+        printf("written to:  %s/cover\n", out_dir);
+
+    for (int i = 0; i < input_count; i++) {
+        free(inputs[i].path);
+        free(inputs[i].tuples);
+    }
+    free(inputs);
+    return 0;
+}
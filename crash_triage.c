@@ -0,0 +1,610 @@
+// replays afl crashes/ and hangs/ against the ASAN+UBSAN harness and buckets
+// them by bug class plus the top stack frames, keeping the smallest reproducer
+// per bucket. one forked worker per core decodes inputs in-process through
+// LLVMFuzzerTestOneInput and is only respawned after it dies, so inputs that no
+// longer reproduce cost no fork/exec
+// usage: crash-triage [-j jobs] [-t timeout_ms] [-f frames] [-o out_dir] <dir|file>...
+// build: harness.c with -DHARNESS_NO_MAIN, both against the sanitized libpng-c
+// the decode path comes from the HARNESS_* environment, as in the harness; it has
+// to match the campaign that found the inputs (triage_crashes.sh reads harness.env)
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// workers are forks, so the sanitizer options have to be baked in rather than
+// read from the environment of each replay. ABRT on a hung worker makes ASAN
+// print the stack it was stuck in; a report ends the worker with SIGABRT
+const char *__asan_default_options(void) {
+    return "detect_leaks=0:abort_on_error=1:handle_abort=1:allocator_may_return_null=1";
+}
+
+const char *__ubsan_default_options(void) {
+    return "halt_on_error=1:abort_on_error=1:print_stacktrace=1";
+}
+
+#define MAX_FRAMES 8
+#define MAX_WORKERS 256
+#define REPORT_LIMIT (256 * 1024)
+// after SIGABRT a hung worker gets this long to print its stack
+#define ABORT_GRACE_MS 2000
+
+enum { INPUT_PENDING, INPUT_OK, INPUT_CRASH, INPUT_HANG };
+
+typedef struct {
+    char *path;
+    off_t size;
+    int status;
+} input_t;
+
+typedef struct {
+    uint64_t id;
+    char kind[96];
+    char frames[MAX_FRAMES][128];
+    int frame_count;
+    char location[192];
+    int count;
+    int hangs;
+    int smallest;       // input index
+} bucket_t;
+
+typedef struct {
+    pid_t pid;
+    int cmd_fd;         // parent -> worker: input indices
+    int result_fd;      // worker -> parent: one byte per clean replay, EOF when it dies
+    int log_fd;         // worker stderr, O_APPEND; the parent preads from log_start
+    off_t log_start;
+    int current;        // input being replayed, -1 if idle
+    double deadline;
+    int aborted;
+} worker_t;
+
+static input_t *inputs;
+static int input_count, input_capacity;
+static bucket_t *buckets;
+static int bucket_count, bucket_capacity;
+static worker_t workers[MAX_WORKERS];
+static int worker_count;
+static int top_frames = 3;
+static int timeout_ms = 2000;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void add_input(const char *path, off_t size) {
+    if (input_count == input_capacity) {
+        input_capacity = input_capacity ? input_capacity * 2 : 256;
+        inputs = (input_t *)realloc(inputs, input_capacity * sizeof(input_t));
+        if (!inputs) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    inputs[input_count].path = strdup(path);
+    inputs[input_count].size = size;
+    inputs[input_count].status = INPUT_PENDING;
+    input_count++;
+}
+
+// a file, or every regular file in a directory except afl's README.txt
+static void collect(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return;
+    }
+    if (S_ISREG(st.st_mode)) {
+        add_input(path, st.st_size);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.' || !strcmp(entry->d_name, "README.txt")) continue;
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        if (stat(file, &st) == 0 && S_ISREG(st.st_mode))
+            add_input(file, st.st_size);
+    }
+    closedir(dir);
+}
+
+static int read_full(int fd, void *buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, (char *)buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        done += n;
+    }
+    return 1;
+}
+
+static void replay(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *)malloc(size > 0 ? size : 1);
+    if (data && fread(data, 1, size, fp) == (size_t)size)
+        LLVMFuzzerTestOneInput(data, size);
+    free(data);
+    fclose(fp);
+}
+
+static void worker_main(int cmd_fd, int result_fd) {
+    int index;
+    while (read_full(cmd_fd, &index, sizeof(index))) {
+        replay(inputs[index].path);
+        char ok = 1;
+        if (write(result_fd, &ok, 1) != 1) break;
+    }
+    _exit(0);
+}
+
+static void spawn(worker_t *w) {
+    int cmd[2], result[2];
+    if (pipe(cmd) != 0 || pipe(result) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+    if (ftruncate(w->log_fd, 0) != 0) {
+        perror("ftruncate");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(cmd[1]);
+        close(result[0]);
+        for (int i = 0; i < worker_count; i++) {
+            if (workers[i].pid > 0) {
+                close(workers[i].cmd_fd);
+                close(workers[i].result_fd);
+            }
+        }
+        dup2(w->log_fd, 1);
+        dup2(w->log_fd, 2);
+        worker_main(cmd[0], result[1]);
+    }
+
+    close(cmd[0]);
+    close(result[1]);
+    w->pid = pid;
+    w->cmd_fd = cmd[1];
+    w->result_fd = result[0];
+    w->current = -1;
+}
+
+static void dispatch(worker_t *w, int index) {
+    w->log_start = lseek(w->log_fd, 0, SEEK_END);
+    w->current = index;
+    w->deadline = now_ms() + timeout_ms;
+    w->aborted = 0;
+    if (write(w->cmd_fd, &index, sizeof(index)) != sizeof(index)) {
+        // worker already gone; the poll loop sees EOF on its result pipe
+    }
+}
+
+// frames inside the sanitizer runtime or libc say nothing about the bug
+static int skip_frame(const char *name) {
+    static const char *libc[] = {
+        "memcpy", "memmove", "memset", "memcmp", "strlen", "abort", "raise",
+        "malloc", "calloc", "realloc", "free",
+    };
+    if (!strncmp(name, "__", 2)) return 1;
+    for (size_t i = 0; i < sizeof(libc) / sizeof(libc[0]); i++)
+        if (!strcmp(name, libc[i])) return 1;
+    return 0;
+}
+
+// "#3 0x4f5e2a in png_read_row /path/pngread.c:541:7" or, unsymbolized,
+// "#3 0x4f5e2a  (/path/crash-triage+0x4f5e2a)"; returns 0 if not a frame line
+static int parse_frame(const char *line, char *name, size_t name_size,
+                       char *where, size_t where_size) {
+    while (*line == ' ') line++;
+    if (line[0] != '#' || line[1] < '0' || line[1] > '9') return 0;
+    const char *p = strstr(line, " 0x");
+    if (!p) return 0;
+    p += 3;
+    while (*p && *p != ' ') p++;
+    while (*p == ' ') p++;
+
+    where[0] = 0;
+    if (!strncmp(p, "in ", 3)) {
+        p += 3;
+        size_t n = strcspn(p, " ");
+        snprintf(name, name_size, "%.*s", (int)n, p);
+        p += n;
+        while (*p == ' ') p++;
+        const char *base = strrchr(p, '/');
+        snprintf(where, where_size, "%s", base ? base + 1 : p);
+    } else if (*p == '(') {
+        const char *base = strrchr(p, '/');
+        snprintf(name, name_size, "%s", base ? base + 1 : p + 1);
+        name[strcspn(name, ")")] = 0;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// "runtime error: left shift of 1 by 31 places ..." -> "ubsan: left shift of"
+static void ubsan_kind(const char *message, char *kind, size_t kind_size) {
+    size_t n = 0;
+    while (message[n] && message[n] != '\'' && (message[n] < '0' || message[n] > '9') &&
+           n < 48)
+        n++;
+    while (n > 0 && (message[n - 1] == ' ' || message[n - 1] == ':'))
+        n--;
+    snprintf(kind, kind_size, "ubsan: %.*s", (int)n, message);
+}
+
+static uint64_t fnv1a(uint64_t hash, const char *s) {
+    while (*s) {
+        hash ^= (uint8_t)*s++;
+        hash *= 0x100000001B3ull;
+    }
+    hash ^= '|';
+    return hash * 0x100000001B3ull;
+}
+
+// classify the report a dead worker left behind and file the input in its bucket
+static void file_crash(worker_t *w, int wait_status) {
+    input_t *input = &inputs[w->current];
+    input->status = w->aborted ? INPUT_HANG : INPUT_CRASH;
+
+    static char report[REPORT_LIMIT + 1];
+    ssize_t n = pread(w->log_fd, report, REPORT_LIMIT, w->log_start);
+    report[n > 0 ? n : 0] = 0;
+
+    bucket_t key;
+    memset(&key, 0, sizeof(key));
+    int in_stack = 0, stack_done = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(report, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *hit;
+        if (!key.kind[0] && (hit = strstr(line, "ERROR: AddressSanitizer: "))) {
+            hit += strlen("ERROR: AddressSanitizer: ");
+            snprintf(key.kind, sizeof(key.kind), "%.*s", (int)strcspn(hit, " "), hit);
+            continue;
+        }
+        if (!key.kind[0] && (hit = strstr(line, "runtime error: "))) {
+            ubsan_kind(hit + strlen("runtime error: "), key.kind, sizeof(key.kind));
+            continue;
+        }
+        if (!strncmp(line, "READ of size", 12) || !strncmp(line, "WRITE of size", 13)) {
+            size_t len = strlen(key.kind);
+            snprintf(key.kind + len, sizeof(key.kind) - len, " %s", line[0] == 'R' ? "READ" : "WRITE");
+            continue;
+        }
+
+        // only the first stack: the faulting access, not "allocated by"
+        char name[128], where[192];
+        if (stack_done || !key.kind[0]) continue;
+        if (!parse_frame(line, name, sizeof(name), where, sizeof(where))) {
+            if (in_stack) stack_done = 1;
+            continue;
+        }
+        in_stack = 1;
+        if (!strcmp(name, "LLVMFuzzerTestOneInput") || !strcmp(name, "replay")) {
+            stack_done = 1;
+            continue;
+        }
+        if (skip_frame(name) || key.frame_count >= top_frames) continue;
+        if (key.frame_count == 0)
+            snprintf(key.location, sizeof(key.location), "%s %s", name, where);
+        snprintf(key.frames[key.frame_count++], sizeof(key.frames[0]), "%s", name);
+    }
+
+    if (w->aborted) {
+        snprintf(key.kind, sizeof(key.kind), "timeout");
+    } else if (!key.kind[0]) {
+        if (WIFSIGNALED(wait_status))
+            snprintf(key.kind, sizeof(key.kind), "signal %d", WTERMSIG(wait_status));
+        else
+            snprintf(key.kind, sizeof(key.kind), "exit %d", WEXITSTATUS(wait_status));
+    }
+
+    uint64_t id = fnv1a(0xCBF29CE484222325ull, key.kind);
+    for (int i = 0; i < key.frame_count; i++)
+        id = fnv1a(id, key.frames[i]);
+
+    bucket_t *bucket = NULL;
+    for (int i = 0; i < bucket_count; i++)
+        if (buckets[i].id == id) bucket = &buckets[i];
+    if (!bucket) {
+        if (bucket_count == bucket_capacity) {
+            bucket_capacity = bucket_capacity ? bucket_capacity * 2 : 64;
+            buckets = (bucket_t *)realloc(buckets, bucket_capacity * sizeof(bucket_t));
+            if (!buckets) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        bucket = &buckets[bucket_count++];
+        *bucket = key;
+        bucket->id = id;
+        bucket->smallest = w->current;
+    }
+    bucket->count++;
+    bucket->hangs += w->aborted;
+    if (input->size < inputs[bucket->smallest].size)
+        bucket->smallest = w->current;
+}
+
+static void reap(worker_t *w) {
+    int wait_status = 0;
+    close(w->cmd_fd);
+    close(w->result_fd);
+    waitpid(w->pid, &wait_status, 0);
+    w->pid = 0;
+    if (w->current >= 0)
+        file_crash(w, wait_status);
+    w->current = -1;
+}
+
+static void run_workers(void) {
+    int next = 0, done = 0;
+    struct pollfd fds[MAX_WORKERS];
+
+    while (done < input_count) {
+        int busy = 0;
+        double wake = now_ms() + 1000;
+        for (int i = 0; i < worker_count; i++) {
+            worker_t *w = &workers[i];
+            if (w->current < 0 && next < input_count) {
+                if (w->pid <= 0) spawn(w);
+                dispatch(w, next++);
+            }
+            fds[i].fd = w->current >= 0 ? w->result_fd : -1;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+            if (w->current >= 0) {
+                busy++;
+                if (w->deadline < wake) wake = w->deadline;
+            }
+        }
+        if (!busy) break;
+
+        int wait = (int)(wake - now_ms());
+        if (poll(fds, worker_count, wait > 0 ? wait : 0) < 0 && errno != EINTR) {
+            perror("poll");
+            exit(1);
+        }
+
+        double now = now_ms();
+        for (int i = 0; i < worker_count; i++) {
+            worker_t *w = &workers[i];
+            if (w->current < 0) continue;
+
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char ok;
+                if (read(w->result_fd, &ok, 1) == 1 && !w->aborted) {
+                    inputs[w->current].status = INPUT_OK;
+                    w->current = -1;
+                } else {
+                    reap(w);
+                }
+                done++;
+            } else if (now >= w->deadline) {
+                if (!w->aborted) {
+                    // let ASAN print where it is stuck, then give up on it
+                    kill(w->pid, SIGABRT);
+                    w->aborted = 1;
+                    w->deadline = now + ABORT_GRACE_MS;
+                } else {
+                    kill(w->pid, SIGKILL);
+                    reap(w);
+                    done++;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        if (workers[i].pid > 0) {
+            close(workers[i].cmd_fd);
+            close(workers[i].result_fd);
+            waitpid(workers[i].pid, NULL, 0);
+        }
+    }
+}
+
+static void json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(fp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(fp, "\\u%04x", *s);
+        else fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+static int by_count(const void *a, const void *b) {
+    const bucket_t *x = (const bucket_t *)a, *y = (const bucket_t *)b;
+    return y->count - x->count;
+}
+
+static void copy_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    FILE *out = in ? fopen(to, "wb") : NULL;
+    char buf[65536];
+    size_t n;
+    while (out && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+        fwrite(buf, 1, n, out);
+    if (out) fclose(out);
+    if (in) fclose(in);
+}
+
+static void write_results(const char *out_dir, int counts[4]) {
+    char path[4096];
+    mkdir(out_dir, 0755);
+    snprintf(path, sizeof(path), "%s/reproducers", out_dir);
+    mkdir(path, 0755);
+
+    if (bucket_count > 1)
+        qsort(buckets, bucket_count, sizeof(bucket_t), by_count);
+
+    snprintf(path, sizeof(path), "%s/triage.json", out_dir);
+    FILE *json = fopen(path, "w");
+    snprintf(path, sizeof(path), "%s/triage.md", out_dir);
+    FILE *md = fopen(path, "w");
+    if (!json || !md) {
+        perror(path);
+        exit(1);
+    }
+
+    fprintf(json, "{\n  \"inputs\": %d,\n  \"crashes\": %d,\n  \"hangs\": %d,\n"
+                  "  \"no_repro\": %d,\n  \"harness_env\": [",
+            input_count, counts[INPUT_CRASH], counts[INPUT_HANG], counts[INPUT_OK]);
+    fprintf(md, "# Crash triage\n\n%d inputs: %d crashes, %d hangs, %d did not reproduce; "
+                "%d buckets (top %d frames).\n\nReplayed with:",
+            input_count, counts[INPUT_CRASH], counts[INPUT_HANG], counts[INPUT_OK],
+            bucket_count, top_frames);
+
+    // the decode path the inputs went down; "no repro" only means something for this one
+    int env_count = 0;
+    for (char **env = environ; *env; env++) {
+        if (strncmp(*env, "HARNESS_", 8)) continue;
+        if (env_count++) fprintf(json, ", ");
+        json_string(json, *env);
+        fprintf(md, " `%s`", *env);
+    }
+    fprintf(json, "],\n  \"buckets\": [\n");
+    fprintf(md, ".\n\n");
+    fprintf(md, "| bucket | class | top frames | location | inputs | smallest reproducer | bytes |\n");
+    fprintf(md, "|--------|-------|------------|----------|-------:|---------------------|------:|\n");
+
+    for (int i = 0; i < bucket_count; i++) {
+        bucket_t *b = &buckets[i];
+        input_t *smallest = &inputs[b->smallest];
+        char id[17];
+        snprintf(id, sizeof(id), "%016llx", (unsigned long long)b->id);
+        snprintf(path, sizeof(path), "%s/reproducers/%s", out_dir, id);
+        copy_file(smallest->path, path);
+
+        fprintf(json, "    {\"id\": \"%s\", \"class\": ", id);
+        json_string(json, b->kind);
+        fprintf(json, ", \"location\": ");
+        json_string(json, b->location);
+        fprintf(json, ", \"frames\": [");
+        for (int f = 0; f < b->frame_count; f++) {
+            if (f) fprintf(json, ", ");
+            json_string(json, b->frames[f]);
+        }
+        fprintf(json, "], \"count\": %d, \"hangs\": %d, \"reproducer\": ", b->count, b->hangs);
+        json_string(json, smallest->path);
+        fprintf(json, ", \"size\": %lld}%s\n", (long long)smallest->size,
+                i + 1 < bucket_count ? "," : "");
+
+        fprintf(md, "| `%s` | %s | ", id, b->kind);
+        for (int f = 0; f < b->frame_count; f++)
+            fprintf(md, "%s`%s`", f ? " < " : "", b->frames[f]);
+        fprintf(md, " | %s | %d | `%s` | %lld |\n", b->location, b->count, smallest->path,
+                (long long)smallest->size);
+    }
+    fprintf(json, "  ]\n}\n");
+    fclose(json);
+    fclose(md);
+}
+
+int main(int argc, char **argv) {
+    const char *out_dir = "triage";
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "j:t:f:o:")) != -1) {
+        switch (opt) {
+            case 'j': jobs = atoi(optarg); break;
+            case 't': timeout_ms = atoi(optarg); break;
+            case 'f': top_frames = atoi(optarg); break;
+            case 'o': out_dir = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-j jobs] [-t timeout_ms] [-f frames] [-o out_dir] "
+                                "<dir|file>...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-j jobs] [-t timeout_ms] [-f frames] [-o out_dir] "
+                        "<dir|file>...\n", argv[0]);
+        return 1;
+    }
+    if (top_frames < 1) top_frames = 1;
+    if (top_frames > MAX_FRAMES) top_frames = MAX_FRAMES;
+
+    for (int i = optind; i < argc; i++)
+        collect(argv[i]);
+    if (input_count == 0) {
+        fprintf(stderr, "no inputs\n");
+        return 1;
+    }
+
+    // same re-encode path as `harness-c-linux @@ out.png`, unless overridden
+    setenv("HARNESS_SINK", "mem", 0);
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    worker_count = jobs < 1 ? 1 : jobs > MAX_WORKERS ? MAX_WORKERS : jobs;
+    if (worker_count > input_count) worker_count = input_count;
+    for (int i = 0; i < worker_count; i++) {
+        char log_path[] = "/tmp/crash-triage-XXXXXX";
+        int fd = mkstemp(log_path);
+        if (fd < 0) {
+            perror("mkstemp");
+            return 1;
+        }
+        unlink(log_path);
+        fcntl(fd, F_SETFL, O_APPEND);
+        workers[i].log_fd = fd;
+        workers[i].current = -1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    double start = now_ms();
+    run_workers();
+    double elapsed = now_ms() - start;
+
+    int counts[4] = {0};
+    for (int i = 0; i < input_count; i++)
+        counts[inputs[i].status]++;
+    write_results(out_dir, counts);
+
+    printf("inputs:      %d (%d workers, %.2f s, %.0f inputs/s)\n", input_count, worker_count,
+           elapsed / 1e3, input_count / (elapsed / 1e3));
+    printf("crashes:     %d\n", counts[INPUT_CRASH]);
+    printf("hangs:       %d\n", counts[INPUT_HANG]);
+    printf("no repro:    %d\n", counts[INPUT_OK]);
+    printf("buckets:     %d\n", bucket_count);
+    printf("results:     %s/triage.json, %s/triage.md, %s/reproducers/\n",
+           out_dir, out_dir, out_dir);
+    return 0;
+}
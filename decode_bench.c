@@ -0,0 +1,368 @@
+// per-stage timing of harness.c's decode path over a corpus: png_read_info,
+// transform setup, png_read_image, png_read_end and the re-encode are timed
+// separately through harness.c's HARNESS_STAGE marks. each iteration is one
+// pass over every input; percentiles are over passes, plus per-decode latency
+// and the decoder's heap peak per decode
+// usage: decode-bench [-n iterations] [-w warmup] [-l label] [-p] [-x spec]... [-c] <dir|file>...
+//   -p decodes through the push-mode png_process_data path (HARNESS_PROGRESSIVE=1),
+//      fragment size from HARNESS_FEED
+//   -x measures MB/s per transform combination instead of per stage, one pass set
+//      per spec (HARNESS_TRANSFORMS syntax, e.g. none, gamma+bgr, simplified)
+//   -c prints one csv row per metric (label,metric,p50,p90,p99,mean): stages in us
+//      per pass, decode_latency in us, heap_peak in bytes (left out when simplified
+//      decodes bypass the counting allocator), mb_per_s at each pass time,
+//      xform:<spec> in MB/s at each pass time
+// build: harness.c with -DHARNESS_NO_MAIN -DHARNESS_STAGE_HOOK, same flags as the library
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// must match the STAGE_* enum in harness.c
+enum { STAGE_INFO, STAGE_TRANSFORMS, STAGE_IMAGE, STAGE_END, STAGE_ENCODE, STAGE_COUNT };
+
+static const char *stage_names[STAGE_COUNT + 1] = {
+    "read_info", "transforms", "read_image", "read_end", "encode", "total",
+};
+
+#define MAX_INPUTS 4096
+#define MAX_SIZE (8 * 1024 * 1024)
+#define MAX_SPECS 64
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} input_t;
+
+static input_t inputs[MAX_INPUTS];
+static int input_count;
+
+// decoder heap high-water mark, kept by harness.c's counting allocator. the
+// simplified API allocates inside libpng and only sets harness_heap_partial
+extern size_t harness_heap_peak;
+extern int harness_heap_partial;
+
+// filled by harness_stage during one decode
+static double stage_ns[STAGE_COUNT];
+static double last_mark;
+static int reached_end;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void harness_stage(int stage) {
+    double now = now_ns();
+    stage_ns[stage] += now - last_mark;
+    last_mark = now;
+    if (stage == STAGE_END)
+        reached_end = 1;
+}
+
+static void add_file(const char *path) {
+    if (input_count >= MAX_INPUTS) return;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size > 0 && size <= MAX_SIZE) {
+        uint8_t *data = (uint8_t *)malloc(size);
+        if (data && fread(data, 1, size, fp) == (size_t)size) {
+            inputs[input_count].data = data;
+            inputs[input_count].size = size;
+            input_count++;
+        } else {
+            free(data);
+        }
+    }
+    fclose(fp);
+}
+
+// a file, or every .png in a directory (pngsuite ships other files alongside)
+static void collect(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return;
+    }
+    if (S_ISREG(st.st_mode)) {
+        add_file(path);
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        perror(path);
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        size_t len = strlen(entry->d_name);
+        if (entry->d_name[0] == '.' || len < 4 || strcmp(entry->d_name + len - 4, ".png"))
+            continue;
+        char file[4096];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        add_file(file);
+    }
+    closedir(dir);
+}
+
+static int by_value(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of a sorted array
+static double percentile(const double *sorted, long count, double p) {
+    long rank = (long)(p / 100.0 * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static double mean(const double *values, long count) {
+    double sum = 0;
+    for (long i = 0; i < count; i++)
+        sum += values[i];
+    return count ? sum / count : 0;
+}
+
+// one pass set per transform spec: total time per pass only, no stage split.
+// the harness re-reads HARNESS_TRANSFORMS on every LLVMFuzzerInitialize
+static int bench_transforms(char **specs, int spec_count, long iterations, long warmup,
+                            const char *label, int csv, size_t pass_bytes, int *argc,
+                            char ***argv) {
+    double *pass = (double *)malloc(iterations * sizeof(double));
+    if (!pass) {
+        perror("malloc");
+        return 1;
+    }
+
+    double baseline = 0;
+    if (!csv) {
+        printf("%s: %d inputs, %zu bytes, %ld passes per spec\n", label, input_count,
+               pass_bytes, iterations);
+        printf("%-32s %10s %10s %10s %9s %9s %8s\n", "transforms", "MB/s p50", "MB/s p90",
+               "MB/s p99", "rejected", "heap KB", "vs first");
+    }
+
+    for (int x = 0; x < spec_count; x++) {
+        setenv("HARNESS_TRANSFORMS", specs[x], 1);
+        LLVMFuzzerInitialize(argc, argv);
+
+        long rejected = 0;
+        double heap_max = 0;
+        int heap_partial = 0;
+        memset(pass, 0, iterations * sizeof(double));
+        for (long it = -warmup; it < iterations; it++) {
+            for (int i = 0; i < input_count; i++) {
+                reached_end = 0;
+                harness_heap_peak = 0;
+                harness_heap_partial = 0;
+                double start = now_ns();
+                last_mark = start;
+                LLVMFuzzerTestOneInput(inputs[i].data, inputs[i].size);
+                double total = now_ns() - start;
+                if (it < 0) continue;
+                pass[it] += total / 1e3;
+                if (it == 0) {
+                    rejected += !reached_end;
+                    heap_partial |= harness_heap_partial;
+                    if (harness_heap_peak > heap_max)
+                        heap_max = (double)harness_heap_peak;
+                }
+            }
+        }
+        qsort(pass, iterations, sizeof(double), by_value);
+
+        double p50 = pass_bytes / percentile(pass, iterations, 50);
+        if (x == 0)
+            baseline = p50;
+        if (csv) {
+            printf("%s,xform:%s,%.2f,%.2f,%.2f,%.2f\n", label, specs[x], p50,
+                   pass_bytes / percentile(pass, iterations, 90),
+                   pass_bytes / percentile(pass, iterations, 99),
+                   pass_bytes / mean(pass, iterations));
+        } else {
+            char heap_kb[16];
+            if (heap_partial)
+                snprintf(heap_kb, sizeof(heap_kb), "n/a");
+            else
+                snprintf(heap_kb, sizeof(heap_kb), "%.1f", heap_max / 1024);
+            printf("%-32s %10.1f %10.1f %10.1f %9ld %9s %7.2fx\n", specs[x], p50,
+                   pass_bytes / percentile(pass, iterations, 90),
+                   pass_bytes / percentile(pass, iterations, 99), rejected, heap_kb,
+                   baseline > 0 ? p50 / baseline : 0);
+        }
+    }
+
+    free(pass);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    long iterations = 200;
+    long warmup = 5;
+    const char *label = "decode";
+    int csv = 0;
+    int progressive = 0;
+    char *specs[MAX_SPECS];
+    int spec_count = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:l:px:c")) != -1) {
+        switch (opt) {
+        case 'n': iterations = atol(optarg); break;
+        case 'w': warmup = atol(optarg); break;
+        case 'l': label = optarg; break;
+        case 'p': progressive = 1; break;
+        case 'x':
+            if (spec_count < MAX_SPECS) specs[spec_count++] = optarg;
+            break;
+        case 'c': csv = 1; break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind >= argc || iterations < 1) {
+        fprintf(stderr,
+                "Usage: %s [-n iterations] [-w warmup] [-l label] [-p] [-x spec]... [-c] "
+                "<dir|file>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++)
+        collect(argv[i]);
+    if (input_count == 0) {
+        fprintf(stderr, "no inputs\n");
+        return 1;
+    }
+
+    // time the re-encode too, as `harness @@ out.png` runs it, unless overridden.
+    // transform specs measure the conversions alone, most change the row format anyway
+    setenv("HARNESS_SINK", spec_count ? "none" : "mem", 0);
+    if (progressive)
+        setenv("HARNESS_PROGRESSIVE", "1", 1);
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    size_t pass_bytes = 0;
+    for (int i = 0; i < input_count; i++)
+        pass_bytes += inputs[i].size;
+
+    if (spec_count) {
+        int status = bench_transforms(specs, spec_count, iterations, warmup, label, csv,
+                                      pass_bytes, &argc, &argv);
+        for (int i = 0; i < input_count; i++)
+            free(inputs[i].data);
+        return status;
+    }
+
+    // pass[stage][iteration]: microseconds spent in that stage over one full pass
+    double *pass[STAGE_COUNT + 1];
+    for (int s = 0; s <= STAGE_COUNT; s++) {
+        pass[s] = (double *)calloc(iterations, sizeof(double));
+        if (!pass[s]) {
+            perror("calloc");
+            return 1;
+        }
+    }
+    double *latency = (double *)malloc((size_t)iterations * input_count * sizeof(double));
+    // heap peak is deterministic per input, so it is sampled on the first pass only
+    double *heap = (double *)malloc(input_count * sizeof(double));
+    if (!latency || !heap) {
+        perror("malloc");
+        return 1;
+    }
+    long decodes = 0, rejected = 0;
+    int heap_partial = 0;
+
+    for (long it = -warmup; it < iterations; it++) {
+        for (int i = 0; i < input_count; i++) {
+            memset(stage_ns, 0, sizeof(stage_ns));
+            reached_end = 0;
+            double start = now_ns();
+            last_mark = start;
+            harness_heap_peak = 0;
+            harness_heap_partial = 0;
+            LLVMFuzzerTestOneInput(inputs[i].data, inputs[i].size);
+            double total = now_ns() - start;
+            if (it < 0) continue;
+            if (it == 0) {
+                heap[i] = (double)harness_heap_peak;
+                heap_partial |= harness_heap_partial;
+            }
+
+            for (int s = 0; s < STAGE_COUNT; s++)
+                pass[s][it] += stage_ns[s] / 1e3;
+            pass[STAGE_COUNT][it] += total / 1e3;
+            latency[decodes++] = total / 1e3;
+            // pngsuite's x* files are meant to fail; count them, their time stays in
+            rejected += (it == 0 && !reached_end);
+        }
+    }
+
+    for (int s = 0; s <= STAGE_COUNT; s++)
+        qsort(pass[s], iterations, sizeof(double), by_value);
+    qsort(latency, decodes, sizeof(double), by_value);
+    qsort(heap, input_count, sizeof(double), by_value);
+
+    if (csv) {
+        for (int s = 0; s <= STAGE_COUNT; s++)
+            printf("%s,%s,%.1f,%.1f,%.1f,%.1f\n", label, stage_names[s],
+                   percentile(pass[s], iterations, 50), percentile(pass[s], iterations, 90),
+                   percentile(pass[s], iterations, 99), mean(pass[s], iterations));
+        printf("%s,decode_latency,%.1f,%.1f,%.1f,%.1f\n", label,
+               percentile(latency, decodes, 50), percentile(latency, decodes, 90),
+               percentile(latency, decodes, 99), mean(latency, decodes));
+        if (!heap_partial)
+            printf("%s,heap_peak,%.0f,%.0f,%.0f,%.0f\n", label,
+                   percentile(heap, input_count, 50), percentile(heap, input_count, 90),
+                   percentile(heap, input_count, 99), mean(heap, input_count));
+        printf("%s,mb_per_s,%.2f,%.2f,%.2f,%.2f\n", label,
+               pass_bytes / percentile(pass[STAGE_COUNT], iterations, 50),
+               pass_bytes / percentile(pass[STAGE_COUNT], iterations, 90),
+               pass_bytes / percentile(pass[STAGE_COUNT], iterations, 99),
+               pass_bytes / mean(pass[STAGE_COUNT], iterations));
+    } else {
+        double p50_total = percentile(pass[STAGE_COUNT], iterations, 50);
+        printf("%s: %d inputs (%d rejected before read_end), %zu bytes, %ld passes\n",
+               label, input_count, (int)rejected, pass_bytes, iterations);
+        printf("%-14s %12s %12s %12s %12s %7s\n", "stage (us/pass)", "p50", "p90", "p99",
+               "mean", "share");
+        for (int s = 0; s <= STAGE_COUNT; s++) {
+            double p50 = percentile(pass[s], iterations, 50);
+            printf("%-15s %12.1f %12.1f %12.1f %12.1f %6.1f%%\n", stage_names[s], p50,
+                   percentile(pass[s], iterations, 90), percentile(pass[s], iterations, 99),
+                   mean(pass[s], iterations), p50_total > 0 ? 100.0 * p50 / p50_total : 0);
+        }
+        printf("per decode (us): p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+               percentile(latency, decodes, 50), percentile(latency, decodes, 90),
+               percentile(latency, decodes, 99), latency[decodes - 1]);
+        printf("throughput:      %.1f MB/s of png input, %.0f decodes/s\n",
+               pass_bytes / p50_total, input_count / (p50_total / 1e6));
+        if (heap_partial)
+            printf("heap peak (KB):  not measured, png_image_* allocates inside libpng\n");
+        else
+            printf("heap peak (KB):  p50 %.1f, p99 %.1f, max %.1f per decode\n",
+                   percentile(heap, input_count, 50) / 1024,
+                   percentile(heap, input_count, 99) / 1024, heap[input_count - 1] / 1024);
+    }
+
+    for (int s = 0; s <= STAGE_COUNT; s++)
+        free(pass[s]);
+    free(latency);
+    free(heap);
+    for (int i = 0; i < input_count; i++)
+        free(inputs[i].data);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#!/bin/bash
+
+# Linux - merge the queues of every campaign under build/output-* into one
+# compact seed set: corpus-distill keeps the fewest inputs that preserve every
+# edge/hit-count tuple, then afl-tmin shrinks each survivor in parallel.
+# The result seeds the next campaign, e.g. ./run_campaign_linux.sh -i build/distilled/seeds
+#
+# usage: ./distill_corpus.sh [options] [dir...]
+#   -j JOBS     parallel workers (default: all cores)
+#   -t MS       per-input timeout (default: 1000)
+#   -o DIR      output directory (default: build/distilled)
+#   -M          skip afl-tmin, keep the set cover as is
+#   -f          replace the output directory even if it is not empty
+#   dir...      queues or seed dirs to merge (default: every queue under build/output-*)
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${SCRIPT_DIR}/build"
+DISTILL="${BUILD_DIR}/corpus-distill"
+AFL_TMIN="${BUILD_DIR}/AFLplusplus/afl-tmin"
+
+JOBS=$(nproc)
+TIMEOUT=1000
+OUTPUT_DIR="${BUILD_DIR}/distilled"
+MINIMIZE=1
+FORCE=0
+
+while getopts "j:t:o:Mf" opt; do
+    case $opt in
+        j) JOBS=$OPTARG ;;
+        t) TIMEOUT=$OPTARG ;;
+        o) OUTPUT_DIR=$OPTARG ;;
+        M) MINIMIZE=0 ;;
+        f) FORCE=1 ;;
+        *) sed -n '8,15p' "$0"; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ ! -x "${DISTILL}" ]; then
+    echo "ERROR: ${DISTILL} not found. Please run build_linux.sh first."
+    exit 1
+fi
+
+# default/queue of single runs, main/ and sec*/ of campaigns, scale-N/ of scaling runs
+DIRS=("$@")
+if [ ${#DIRS[@]} -eq 0 ]; then
+    while IFS= read -r dir; do
+        DIRS+=("$dir")
+    done < <(find "${BUILD_DIR}"/output-* -maxdepth 3 -type d -name queue 2>/dev/null | sort)
+fi
+if [ ${#DIRS[@]} -eq 0 ]; then
+    echo "No queue directories under ${BUILD_DIR}/output-*"
+    exit 1
+fi
+
+echo "===== Corpus Distillation ====="
+# -o may point anywhere, so only an empty or missing directory is replaced without -f
+if [ -d "${OUTPUT_DIR}" ] && [ -n "$(ls -A "${OUTPUT_DIR}")" ] && [ "$FORCE" -eq 0 ]; then
+    echo "ERROR: ${OUTPUT_DIR} is not empty; remove it or pass -f to replace it"
+    exit 1
+fi
+rm -rf "${OUTPUT_DIR}"
+mkdir -p "${OUTPUT_DIR}"
+
+echo ""
+echo "Step 1: Coverage and set cover over ${#DIRS[@]} directories..."
+"${DISTILL}" -j "${JOBS}" -t "${TIMEOUT}" -o "${OUTPUT_DIR}" "${DIRS[@]}" \
+    | tee "${OUTPUT_DIR}/distill.log"
+
+if [ "$MINIMIZE" -eq 0 ] || [ ! -x "${AFL_TMIN}" ]; then
+    [ "$MINIMIZE" -eq 1 ] && echo "afl-tmin not found, keeping the set cover unminimized"
+    cp -r "${OUTPUT_DIR}/cover" "${OUTPUT_DIR}/seeds"
+else
+    echo ""
+    echo "Step 2: afl-tmin on $(ls "${OUTPUT_DIR}/cover" | wc -l) inputs, ${JOBS} at a time..."
+    mkdir -p "${OUTPUT_DIR}/seeds" "${OUTPUT_DIR}/tmin-logs"
+
+    # persistent harness reads the testcase from shared memory, no @@
+    if [ -x "${BUILD_DIR}/harness-b-persistent" ]; then
+        TARGET=("${BUILD_DIR}/harness-b-persistent")
+    else
+        TARGET=("${BUILD_DIR}/harness-b" @@)
+    fi
+
+    export AFL_TMIN OUTPUT_DIR TIMEOUT
+    # an input afl-tmin cannot handle (e.g. it hangs under the fork server) stays as is.
+    # the target command follows the file name as separate arguments, so paths keep their spaces
+    ls "${OUTPUT_DIR}/cover" | xargs -P "${JOBS}" -I{} bash -c '
+        name=$1
+        shift
+        "${AFL_TMIN}" -i "${OUTPUT_DIR}/cover/${name}" -o "${OUTPUT_DIR}/seeds/${name}" \
+            -t "${TIMEOUT}" -m none -- "$@" \
+            > "${OUTPUT_DIR}/tmin-logs/${name}.log" 2>&1 \
+            && [ -s "${OUTPUT_DIR}/seeds/${name}" ] \
+            || cp "${OUTPUT_DIR}/cover/${name}" "${OUTPUT_DIR}/seeds/${name}"
+    ' _ {} "${TARGET[@]}"
+fi
+
+# afl-tmin keeps each input's hit-count map, so the union should not move
+echo ""
+echo "Step 3: Re-measuring coverage of the final seeds..."
+"${DISTILL}" -j "${JOBS}" -t "${TIMEOUT}" "${OUTPUT_DIR}/seeds" | tee "${OUTPUT_DIR}/verify.log"
+
+BEFORE=$(awk '$1 == "tuples:" { print $2 }' "${OUTPUT_DIR}/distill.log")
+AFTER=$(awk '$1 == "tuples:" { print $2 }' "${OUTPUT_DIR}/verify.log")
+
+echo ""
+echo "===== Results ====="
+echo "Seeds:            $(ls "${OUTPUT_DIR}/seeds" | wc -l) files, $(cat "${OUTPUT_DIR}"/seeds/* | wc -c) bytes"
+echo "Tuples merged:    ${BEFORE}"
+echo "Tuples in seeds:  ${AFTER}"
+echo "Seed directory:   ${OUTPUT_DIR}/seeds"
@@ -2,121 +2,96 @@
 
 # Extract results from fuzzing runs to help fill in ANALYSIS.md
 
+# machine specs from the OS actually running: sysctl/sw_vers only exist on macOS
+if [ "$(uname -s)" = "Darwin" ]; then
+    CPU_MODEL=$(sysctl -n machdep.cpu.brand_string)
+    CORES=$(sysctl -n hw.ncpu)
+    RAM_GB=$(($(sysctl -n hw.memsize) / 1024 / 1024 / 1024))
+    OS_NAME="$(sw_vers -productName) $(sw_vers -productVersion)"
+else
+    # arm64 /proc/cpuinfo has no "model name", lscpu still reports one
+    CPU_MODEL=$(awk -F': *' '/^model name/ { print $2; exit }' /proc/cpuinfo)
+    [ -n "${CPU_MODEL}" ] || CPU_MODEL=$(lscpu 2>/dev/null | awk -F': *' '/^Model name/ { print $2; exit }')
+    CORES=$(nproc)
+    RAM_GB=$(awk '/^MemTotal:/ { printf "%d", $2 / 1024 / 1024 + 0.5 }' /proc/meminfo)
+    OS_NAME="$( (. /etc/os-release && echo "${PRETTY_NAME}") 2>/dev/null || uname -sr)"
+fi
+
 echo "======================================"
 echo "Machine Specifications"
 echo "======================================"
-echo "CPU: $(sysctl -n machdep.cpu.brand_string)"
-echo "RAM: $(($(sysctl -n hw.memsize) / 1024 / 1024 / 1024)) GB"
-echo "OS: $(sw_vers -productName) $(sw_vers -productVersion)"
+echo "CPU: ${CPU_MODEL:-unknown}"
+echo "Cores: ${CORES}"
+echo "RAM: ${RAM_GB} GB"
+echo "OS: ${OS_NAME}"
+echo "Kernel: $(uname -sr)"
 echo "Architecture: $(uname -m)"
 echo ""
 
-echo "======================================"
-echo "Part B.1: No Seeds"
-echo "======================================"
-if [ -f build/output-b1-no-seeds/default/plot_data ]; then
-    LAST_LINE=$(tail -1 build/output-b1-no-seeds/default/plot_data)
-    echo "Raw data: $LAST_LINE"
-    echo ""
+# one column of the last plot_data row, looked up by the name in the header line
+# since the column set differs between afl++ versions
+plot_value() {
+    { head -n 1 "$1"; tail -n 1 "$1"; } | awk -F', *' -v name="$2" '
+        NR == 1 { sub(/^# */, ""); for (i = 1; i <= NF; i++) if ($i == name) col = i; next }
+        col { print $col }'
+}
 
-    # Parse the CSV line
-    IFS=',' read -ra FIELDS <<< "$LAST_LINE"
-    echo "Duration: ${FIELDS[0]} seconds"
-    echo "Cycles: ${FIELDS[1]}"
-    echo "Corpus count: ${FIELDS[3]}"
-    echo "Map size: ${FIELDS[6]}"
-    echo "Saved crashes: ${FIELDS[7]}"
-    echo "Max depth: ${FIELDS[9]}"
-    echo "Exec/sec: ${FIELDS[10]}"
-    echo "Total execs: ${FIELDS[11]}"
-    echo "Edges found: ${FIELDS[12]}"
-    echo "Total crashes: ${FIELDS[13]}"
-    echo ""
-    echo "Crashes found:"
-    ls -la build/output-b1-no-seeds/default/crashes/ 2>/dev/null || echo "No crashes directory"
-else
-    echo "NOT RUN YET"
-fi
-echo ""
+show_run() {
+    local title=$1
+    local dir=$2
+    local missing=$3
+    local plot="${dir}/default/plot_data"
 
-echo "======================================"
-echo "Part B.2: With Seeds"
-echo "======================================"
-if [ -f build/output-b2-with-seeds/default/plot_data ]; then
-    LAST_LINE=$(tail -1 build/output-b2-with-seeds/default/plot_data)
-    echo "Raw data: $LAST_LINE"
+    echo "======================================"
+    echo "${title}"
+    echo "======================================"
+    if [ -f "${plot}" ]; then
+        echo "Raw data: $(tail -1 "${plot}")"
+        echo ""
+        echo "Duration: $(plot_value "${plot}" relative_time) seconds"
+        echo "Cycles: $(plot_value "${plot}" cycles_done)"
+        echo "Corpus count: $(plot_value "${plot}" corpus_count)"
+        echo "Map size: $(plot_value "${plot}" map_size)"
+        echo "Saved crashes: $(plot_value "${plot}" saved_crashes)"
+        echo "Max depth: $(plot_value "${plot}" max_depth)"
+        echo "Exec/sec: $(plot_value "${plot}" execs_per_sec)"
+        echo "Total execs: $(plot_value "${plot}" total_execs)"
+        echo "Edges found: $(plot_value "${plot}" edges_found)"
+        echo "Total crashes: $(plot_value "${plot}" total_crashes)"
+        echo ""
+        echo "Crashes found:"
+        ls -la "${dir}/default/crashes/" 2>/dev/null || echo "No crashes directory"
+    else
+        echo "${missing}"
+    fi
     echo ""
+}
 
-    IFS=',' read -ra FIELDS <<< "$LAST_LINE"
-    echo "Duration: ${FIELDS[0]} seconds"
-    echo "Cycles: ${FIELDS[1]}"
-    echo "Corpus count: ${FIELDS[3]}"
-    echo "Map size: ${FIELDS[6]}"
-    echo "Saved crashes: ${FIELDS[7]}"
-    echo "Max depth: ${FIELDS[9]}"
-    echo "Exec/sec: ${FIELDS[10]}"
-    echo "Total execs: ${FIELDS[11]}"
-    echo "Edges found: ${FIELDS[12]}"
-    echo "Total crashes: ${FIELDS[13]}"
-    echo ""
-    echo "Crashes found:"
-    ls -la build/output-b2-with-seeds/default/crashes/ 2>/dev/null || echo "No crashes directory"
-else
-    echo "NOT RUN YET"
-fi
-echo ""
+show_run "Part B.1: No Seeds" build/output-b1-no-seeds "NOT RUN YET"
+show_run "Part B.2: With Seeds" build/output-b2-with-seeds "NOT RUN YET"
+show_run "Part C: Sanitizers" build/output-c-sanitizers "SKIPPED (macOS ASAN issues)"
+show_run "Part D: Custom Mutator" build/output-d-custom-mutator "NOT RUN YET"
 
 echo "======================================"
-echo "Part C: Sanitizers"
+echo "Campaign Telemetry"
 echo "======================================"
-if [ -f build/output-c-sanitizers/default/plot_data ]; then
-    LAST_LINE=$(tail -1 build/output-c-sanitizers/default/plot_data)
-    echo "Raw data: $LAST_LINE"
-    echo ""
-
-    IFS=',' read -ra FIELDS <<< "$LAST_LINE"
-    echo "Duration: ${FIELDS[0]} seconds"
-    echo "Cycles: ${FIELDS[1]}"
-    echo "Corpus count: ${FIELDS[3]}"
-    echo "Map size: ${FIELDS[6]}"
-    echo "Saved crashes: ${FIELDS[7]}"
-    echo "Max depth: ${FIELDS[9]}"
-    echo "Exec/sec: ${FIELDS[10]}"
-    echo "Total execs: ${FIELDS[11]}"
-    echo "Edges found: ${FIELDS[12]}"
-    echo "Total crashes: ${FIELDS[13]}"
-    echo ""
-    echo "Crashes found:"
-    ls -la build/output-c-sanitizers/default/crashes/ 2>/dev/null || echo "No crashes directory"
+if [ -f build/telemetry/alerts.log ]; then
+    echo "Time series: build/telemetry/telemetry.csv ($(($(wc -l < build/telemetry/telemetry.csv) - 1)) samples)"
+    echo "Alerts:"
+    cat build/telemetry/alerts.log
+    [ -s build/telemetry/alerts.log ] || echo "  none"
 else
-    echo "SKIPPED (macOS ASAN issues)"
+    echo "NOT RUN YET (./campaign_monitor.sh samples running campaigns)"
 fi
 echo ""
 
 echo "======================================"
-echo "Part D: Custom Mutator"
+echo "Crash Triage"
 echo "======================================"
-if [ -f build/output-d-custom-mutator/default/plot_data ]; then
-    LAST_LINE=$(tail -1 build/output-d-custom-mutator/default/plot_data)
-    echo "Raw data: $LAST_LINE"
-    echo ""
-
-    IFS=',' read -ra FIELDS <<< "$LAST_LINE"
-    echo "Duration: ${FIELDS[0]} seconds"
-    echo "Cycles: ${FIELDS[1]}"
-    echo "Corpus count: ${FIELDS[3]}"
-    echo "Map size: ${FIELDS[6]}"
-    echo "Saved crashes: ${FIELDS[7]}"
-    echo "Max depth: ${FIELDS[9]}"
-    echo "Exec/sec: ${FIELDS[10]}"
-    echo "Total execs: ${FIELDS[11]}"
-    echo "Edges found: ${FIELDS[12]}"
-    echo "Total crashes: ${FIELDS[13]}"
-    echo ""
-    echo "Crashes found:"
-    ls -la build/output-d-custom-mutator/default/crashes/ 2>/dev/null || echo "No crashes directory"
+if [ -f build/triage/triage.md ]; then
+    cat build/triage/triage.md
 else
-    echo "NOT RUN YET"
+    echo "NOT RUN YET (./triage_crashes.sh buckets the crashes above by stack hash)"
 fi
 echo ""
 
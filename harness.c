@@ -1,64 +1,419 @@
 #include <png.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <zlib.h>
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <input.png> [output.png]\n", argv[0]);
-        return 0;
+// in-memory source for png_set_read_fn, avoids FILE* per exec
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} mem_reader_t;
+
+static void mem_read_fn(png_structp png, png_bytep out, png_size_t len) {
+    mem_reader_t *reader = (mem_reader_t *)png_get_io_ptr(png);
+    if (len > reader->size - reader->pos)
+        png_error(png, "read past end of input");
+    memcpy(out, reader->data + reader->pos, len);
+    reader->pos += len;
+}
+
+// stage boundaries for decode_bench.c, which builds with -DHARNESS_STAGE_HOOK;
+// each mark closes the stage that just ran. compiles away everywhere else
+enum {
+    STAGE_INFO,        // png_read_info
+    STAGE_TRANSFORMS,  // transform setup and png_read_update_info
+    STAGE_IMAGE,       // row buffers and png_read_image / png_read_row
+    STAGE_END,         // png_read_end
+    STAGE_ENCODE,      // every writer_* call
+    STAGE_COUNT,
+};
+
+#ifdef HARNESS_STAGE_HOOK
+void harness_stage(int stage);
+#define HARNESS_STAGE(stage) harness_stage(stage)
+#else
+#define HARNESS_STAGE(stage) ((void)0)
+#endif
+
+// decoder heap accounting for decode_bench.c: libpng's read struct and the
+// harness's row buffers go through these. plain malloc/free everywhere else
+#ifdef HARNESS_STAGE_HOOK
+static size_t harness_heap_current;
+size_t harness_heap_peak;  // reset by the caller before each decode
+int harness_heap_partial;  // set when libpng allocated outside these, reset by the caller
+
+static void *heap_malloc(size_t size) {
+    size_t *block = (size_t *)malloc(sizeof(size_t) * 2 + size);
+    if (!block) return NULL;
+    block[0] = size;
+    harness_heap_current += size;
+    if (harness_heap_current > harness_heap_peak)
+        harness_heap_peak = harness_heap_current;
+    return block + 2;
+}
+
+static void heap_free(void *ptr) {
+    if (!ptr) return;
+    size_t *block = (size_t *)ptr - 2;
+    harness_heap_current -= block[0];
+    free(block);
+}
+
+static png_voidp png_heap_malloc(png_structp png, png_alloc_size_t size) {
+    (void)png;
+    return heap_malloc(size);
+}
+
+static void png_heap_free(png_structp png, png_voidp ptr) {
+    (void)png;
+    heap_free(ptr);
+}
+
+#define CREATE_READ_STRUCT() \
+    png_create_read_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL, \
+                             NULL, png_heap_malloc, png_heap_free)
+#else
+#define heap_malloc(size) malloc(size)
+#define heap_free(ptr) free(ptr)
+#define CREATE_READ_STRUCT() \
+    png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL)
+#endif
+
+// where the re-encoded image goes. mem is the default for every entry point, so
+// persistent and in-process execs reach png_write_* as well as `@@ out.png` does
+enum {
+    SINK_NONE,     // explicit opt-out, skips png_write_* entirely
+    SINK_NULL,     // count bytes only
+    SINK_MEM,      // reusable growable buffer, never touches disk
+    SINK_FILE,     // mem, then one write of the buffer to the output path
+};
+
+// optional row transforms on top of the fixed RGBA8 set; the simplified bit
+// switches to the png_image_* API, which maps the others onto format flags
+enum {
+    XFORM_STRIP_16 = 1 << 0,    // png_set_strip_16 instead of png_set_scale_16
+    XFORM_GAMMA = 1 << 1,       // png_set_gamma to sRGB
+    XFORM_BACKGROUND = 1 << 2,  // png_set_background, bKGD or mid gray
+    XFORM_ALPHA_MODE = 1 << 3,  // png_set_alpha_mode premultiplied
+    XFORM_QUANTIZE = 1 << 4,    // png_set_quantize onto an 8-color palette
+    XFORM_INVERT = 1 << 5,      // png_set_invert_mono and png_set_invert_alpha
+    XFORM_BGR = 1 << 6,         // png_set_bgr
+    XFORM_INTERLACE = 1 << 7,   // explicit png_set_interlace_handling
+    XFORM_SIMPLIFIED = 1 << 8,  // png_image_begin_read_from_memory / png_image_finish_read
+    XFORM_COUNT = 9,
+    XFORM_ALL = (1 << XFORM_COUNT) - 1,
+    XFORM_INPUT = 1 << 16,      // taken from the input's trailer per decode
+};
+
+static const char *xform_names[XFORM_COUNT] = {
+    "strip_16", "gamma", "background", "alpha_mode", "quantize",
+    "invert", "bgr", "interlace", "simplified",
+};
+
+// runtime knobs, read once from the environment before the fork server starts
+typedef struct {
+    int streaming;                     // HARNESS_STREAM: png_read_row into one reused buffer
+    png_uint_32 max_dimension;         // HARNESS_MAX_DIM: per-axis cap via png_set_user_limits
+    uint64_t max_pixels;               // HARNESS_MAX_PIXELS: width * height budget
+    png_alloc_size_t max_chunk_bytes;  // HARNESS_MAX_CHUNK_BYTES: png_set_chunk_malloc_max
+    int sink;                          // HARNESS_SINK: none, null, mem or file
+    int verify;                        // HARNESS_VERIFY: decode the re-encode and compare pixels
+    int progressive;                   // HARNESS_PROGRESSIVE: push-mode png_process_data path
+    size_t feed_bytes;                 // HARNESS_FEED: push fragment size, 0 = chosen by the input
+    unsigned transforms;               // HARNESS_TRANSFORMS: XFORM_* mask, or XFORM_INPUT
+} harness_config_t;
+
+static harness_config_t config = {
+    0,
+    1 << 14,
+    1 << 22,
+    8 << 20,
+    SINK_MEM,
+    0,
+    0,
+    0,
+    0,
+};
+
+static uint64_t env_u64(const char *name, uint64_t fallback) {
+    const char *value = getenv(name);
+    if (!value || !*value) return fallback;
+    return strtoull(value, NULL, 0);
+}
+
+static int env_sink(const char *name, int fallback) {
+    const char *value = getenv(name);
+    if (!value || !*value) return fallback;
+    if (!strcmp(value, "none")) return SINK_NONE;
+    if (!strcmp(value, "null")) return SINK_NULL;
+    if (!strcmp(value, "mem")) return SINK_MEM;
+    if (!strcmp(value, "file")) return SINK_FILE;
+    fprintf(stderr, "unknown %s=%s, using default\n", name, value);
+    return fallback;
+}
+
+// "input", a number, or names joined by '+' or ',' ("none" for the fixed set alone)
+static unsigned env_transforms(const char *name, unsigned fallback) {
+    const char *value = getenv(name);
+    if (!value || !*value) return fallback;
+    if (!strcmp(value, "input")) return XFORM_INPUT;
+    if (value[0] >= '0' && value[0] <= '9')
+        return (unsigned)strtoul(value, NULL, 0) & XFORM_ALL;
+
+    unsigned mask = 0;
+    while (*value) {
+        size_t len = strcspn(value, "+,");
+        int found = len == 4 && !strncmp(value, "none", 4);
+        for (int i = 0; i < XFORM_COUNT && !found; i++) {
+            if (strlen(xform_names[i]) == len && !strncmp(value, xform_names[i], len)) {
+                mask |= 1u << i;
+                found = 1;
+            }
+        }
+        if (!found)
+            fprintf(stderr, "unknown transform '%.*s' in %s, ignored\n", (int)len, value, name);
+        value += len;
+        if (*value) value++;
     }
+    return mask;
+}
 
-    const char *input_file = argv[1];
-    const char *output_file = (argc >= 3) ? argv[2] : NULL;
+// corners of the rgb cube for XFORM_QUANTIZE; libpng keeps the pointer, so it
+// is static. full quantize builds a 32k-cell table per palette entry on every
+// read struct, so a bigger palette only makes each exec slower
+static png_color quantize_palette[8];
 
-    FILE *fp = fopen(input_file, "rb");
-    if (!fp) {
-        return 0;
+static void load_config(void) {
+    config.streaming = (int)env_u64("HARNESS_STREAM", config.streaming);
+    config.max_dimension = (png_uint_32)env_u64("HARNESS_MAX_DIM", config.max_dimension);
+    config.max_pixels = env_u64("HARNESS_MAX_PIXELS", config.max_pixels);
+    config.max_chunk_bytes = (png_alloc_size_t)env_u64("HARNESS_MAX_CHUNK_BYTES",
+                                                       config.max_chunk_bytes);
+    config.sink = env_sink("HARNESS_SINK", config.sink);
+    config.verify = (int)env_u64("HARNESS_VERIFY", config.verify);
+    config.progressive = (int)env_u64("HARNESS_PROGRESSIVE", config.progressive);
+    config.feed_bytes = (size_t)env_u64("HARNESS_FEED", config.feed_bytes);
+    config.transforms = env_transforms("HARNESS_TRANSFORMS", config.transforms);
+
+    for (int i = 0; i < 8; i++) {
+        quantize_palette[i].red = (i & 4) ? 0xff : 0;
+        quantize_palette[i].green = (i & 2) ? 0xff : 0;
+        quantize_palette[i].blue = (i & 1) ? 0xff : 0;
     }
+}
 
-    // verify png signature
-    unsigned char header[8];
-    if (fread(header, 1, 8, fp) != 8) {
-        fclose(fp);
-        return 0;
+// grow-only output buffer, kept across persistent-mode iterations
+typedef struct {
+    png_bytep data;
+    size_t size;
+    size_t capacity;
+} mem_sink_t;
+
+static mem_sink_t out_sink;
+
+// re-encode side, each call re-arms setjmp so write errors stay local
+typedef struct {
+    png_structp png;
+    png_infop info;
+    mem_sink_t *sink;    // NULL for the counting sink
+    size_t written;
+    png_uint_32 width;
+    png_uint_32 height;
+    size_t rowbytes;
+    uLong crc;           // running crc32 of every row handed to the encoder
+    int failed;
+} png_writer_t;
+
+static void mem_write_fn(png_structp png, png_bytep in, png_size_t len) {
+    png_writer_t *w = (png_writer_t *)png_get_io_ptr(png);
+    w->written += len;
+    if (!w->sink) return;
+
+    mem_sink_t *sink = w->sink;
+    if (len > sink->capacity - sink->size) {
+        size_t capacity = sink->capacity ? sink->capacity : 4096;
+        while (len > capacity - sink->size)
+            capacity *= 2;
+        png_bytep data = (png_bytep)realloc(sink->data, capacity);
+        if (!data)
+            png_error(png, "out of memory");
+        sink->data = data;
+        sink->capacity = capacity;
     }
-    if (png_sig_cmp(header, 0, 8)) {
-        fclose(fp);
+    memcpy(sink->data + sink->size, in, len);
+    sink->size += len;
+}
+
+static void mem_flush_fn(png_structp png) {
+    (void)png;
+}
+
+static void writer_close(png_writer_t *w) {
+    if (w->png) png_destroy_write_struct(&w->png, &w->info);
+    w->png = NULL;
+    w->info = NULL;
+}
+
+static int writer_open(png_writer_t *w, int sink,
+                       png_uint_32 width, png_uint_32 height) {
+    memset(w, 0, sizeof(*w));
+    w->width = width;
+    w->height = height;
+    w->rowbytes = (size_t)width * 4;
+    w->crc = crc32(0L, Z_NULL, 0);
+    if (sink != SINK_NULL) {
+        w->sink = &out_sink;
+        out_sink.size = 0;
+    }
+
+    w->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (w->png) w->info = png_create_info_struct(w->png);
+    if (!w->png || !w->info) {
+        writer_close(w);
         return 0;
     }
 
-    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (!png) {
-        fclose(fp);
+    if (setjmp(png_jmpbuf(w->png))) {
+        w->failed = 1;
+        writer_close(w);
         return 0;
     }
 
+    png_set_write_fn(w->png, w, mem_write_fn, mem_flush_fn);
+
+    png_set_IHDR(w->png, w->info,
+                 width, height, 8,
+                 PNG_COLOR_TYPE_RGBA,
+                 PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_BASE,
+                 PNG_FILTER_TYPE_BASE);
+
+    png_write_info(w->png, w->info);
+    return 1;
+}
+
+static void writer_rows(png_writer_t *w, png_bytepp rows, png_uint_32 count) {
+    if (!w->png) return;
+    if (setjmp(png_jmpbuf(w->png))) {
+        w->failed = 1;
+        writer_close(w);
+        return;
+    }
+    png_write_rows(w->png, rows, count);
+    if (config.verify) {
+        for (png_uint_32 y = 0; y < count; y++)
+            w->crc = crc32(w->crc, rows[y], (uInt)w->rowbytes);
+    }
+}
+
+// decode our own re-encode and abort if its pixels differ from what was written
+static void verify_reencode(const png_writer_t *w) {
+    mem_reader_t reader = { w->sink->data, w->sink->size, 0 };
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png) return;
     png_infop info = png_create_info_struct(png);
     if (!info) {
         png_destroy_read_struct(&png, NULL, NULL);
-        fclose(fp);
-        return 0;
+        return;
     }
 
-    // set up error handling
+    png_bytep volatile row = NULL;
+
     if (setjmp(png_jmpbuf(png))) {
-        png_destroy_read_struct(&png, &info, NULL);
-        fclose(fp);
-        return 0;
+        fprintf(stderr, "verify: re-encoded image does not decode\n");
+        abort();
     }
 
-    png_init_io(png, fp);
-    png_set_sig_bytes(png, 8);
-
+    png_set_read_fn(png, &reader, mem_read_fn);
     png_read_info(png, info);
 
-    // img attributes
-    int width = png_get_image_width(png, info);
-    int height = png_get_image_height(png, info);
+    if (png_get_image_width(png, info) != w->width ||
+        png_get_image_height(png, info) != w->height ||
+        png_get_rowbytes(png, info) != w->rowbytes) {
+        fprintf(stderr, "verify: re-encoded header mismatch\n");
+        abort();
+    }
+
+    row = (png_bytep)malloc(w->rowbytes);
+    if (!row)
+        png_error(png, "out of memory");
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (png_uint_32 y = 0; y < w->height; y++) {
+        png_read_row(png, row, NULL);
+        crc = crc32(crc, row, (uInt)w->rowbytes);
+    }
+    png_read_end(png, NULL);
+
+    if (crc != w->crc) {
+        fprintf(stderr, "verify: re-encoded pixels differ\n");
+        abort();
+    }
+
+    free(row);
+    png_destroy_read_struct(&png, &info, NULL);
+}
+
+static void writer_finish(png_writer_t *w, int sink, const char *output_file) {
+    if (!w->png) return;
+    if (setjmp(png_jmpbuf(w->png))) {
+        w->failed = 1;
+        writer_close(w);
+        return;
+    }
+    png_write_end(w->png, w->info);
+    writer_close(w);
+
+    if (config.verify && w->sink)
+        verify_reencode(w);
+
+    if (sink == SINK_FILE) {
+        FILE *out = fopen(output_file, "wb");
+        if (out) {
+            fwrite(w->sink->data, 1, w->sink->size, out);
+            fclose(out);
+        }
+    }
+}
+
+static void free_rows(png_bytep *row_pointers, png_uint_32 rows) {
+    if (!row_pointers) return;
+    for (png_uint_32 y = 0; y < rows; y++)
+        heap_free(row_pointers[y]);
+    heap_free(row_pointers);
+}
+
+static int resolve_sink(const char *output_file) {
+    int sink = config.sink;
+    if (sink == SINK_FILE && !output_file)
+        sink = SINK_MEM;
+    return sink;
+}
+
+// limits that must be in place before the IHDR is parsed
+static void set_limits(png_structp png) {
+    // oversized IHDRs are rejected inside png_read_info instead of in malloc
+    if (config.max_dimension)
+        png_set_user_limits(png, config.max_dimension, config.max_dimension);
+    if (config.max_chunk_bytes)
+        png_set_chunk_malloc_max(png, config.max_chunk_bytes);
+}
+
+// pixel budget, the RGBA8 transform set and any XFORM_* extras, shared by the
+// pull and push paths. extras that change the row format skip the re-encode
+static void set_transforms(png_structp png, png_infop info, unsigned xforms) {
+    png_uint_32 width = png_get_image_width(png, info);
+    png_uint_32 height = png_get_image_height(png, info);
     png_byte color_type = png_get_color_type(png, info);
     png_byte bit_depth = png_get_bit_depth(png, info);
-    int channels = png_get_channels(png, info);
+
+    if (config.max_pixels && (uint64_t)width * height > config.max_pixels)
+        png_error(png, "image exceeds pixel budget");
 
     if (color_type == PNG_COLOR_TYPE_PALETTE)
         png_set_palette_to_rgb(png);
@@ -73,83 +428,531 @@ int main(int argc, char **argv) {
         color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
         png_set_gray_to_rgb(png);
 
+    // palette without tRNS expands to RGB, it needs the filler too
     if (color_type == PNG_COLOR_TYPE_RGB ||
-        color_type == PNG_COLOR_TYPE_GRAY)
+        color_type == PNG_COLOR_TYPE_GRAY ||
+        color_type == PNG_COLOR_TYPE_PALETTE)
         png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
 
-    if (bit_depth == 16)
-        png_set_scale_16(png);
+    if (bit_depth == 16) {
+        if (xforms & XFORM_STRIP_16)
+            png_set_strip_16(png);
+        else
+            png_set_scale_16(png);
+    }
 
-    png_read_update_info(png, info);
+    // alpha_mode first, libpng wants it before gamma and background
+    if (xforms & XFORM_ALPHA_MODE)
+        png_set_alpha_mode(png, PNG_ALPHA_PREMULTIPLIED, PNG_DEFAULT_sRGB);
 
-    int rowbytes = png_get_rowbytes(png, info);
-    channels = png_get_channels(png, info);
+    if (xforms & XFORM_GAMMA)
+        png_set_gamma(png, PNG_DEFAULT_sRGB, PNG_GAMMA_MAC_18);
 
-    // img data
-    png_bytep *row_pointers = (png_bytep *)malloc(sizeof(png_bytep) * height);
-    if (!row_pointers) {
+    if (xforms & XFORM_BACKGROUND) {
+        png_color_16p file_background;
+        if (png_get_bKGD(png, info, &file_background)) {
+            png_set_background(png, file_background, PNG_BACKGROUND_GAMMA_FILE, 1, 1.0);
+        } else {
+            png_color_16 gray = { 0, 0x80, 0x80, 0x80, 0x80 };
+            png_set_background(png, &gray, PNG_BACKGROUND_GAMMA_SCREEN, 0, 1.0);
+        }
+    }
+
+    if (xforms & XFORM_QUANTIZE)
+        png_set_quantize(png, quantize_palette, 8, 8, NULL, 1);
+
+    if (xforms & XFORM_INVERT) {
+        png_set_invert_mono(png);
+        png_set_invert_alpha(png);
+    }
+
+    if (xforms & XFORM_BGR)
+        png_set_bgr(png);
+}
+
+// decode one png from memory, optionally re-encoding it into the configured sink
+static int decode_png(const uint8_t *data, size_t size, const char *output_file,
+                      unsigned xforms) {
+    // verify png signature
+    if (size < 8 || png_sig_cmp((png_const_bytep)data, 0, 8))
+        return 0;
+
+    mem_reader_t reader = { data, size, 8 };
+    png_writer_t writer;
+    memset(&writer, 0, sizeof(writer));
+
+    // read again after the longjmp target is armed, keep it out of registers
+    volatile int sink = resolve_sink(output_file);
+
+    png_structp png = CREATE_READ_STRUCT();
+    if (!png)
+        return 0;
+
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return 0;
+    }
+
+    // buffers must survive the longjmp so persistent mode does not leak them
+    png_bytep *volatile row_pointers = NULL;
+    volatile png_uint_32 rows_allocated = 0;
+    png_bytep volatile row_buf = NULL;
+
+    // set up error handling
+    if (setjmp(png_jmpbuf(png))) {
+        free_rows(row_pointers, rows_allocated);
+        heap_free(row_buf);
+        writer_close(&writer);
         png_destroy_read_struct(&png, &info, NULL);
-        fclose(fp);
         return 0;
     }
 
-    for (int y = 0; y < height; y++) {
-        row_pointers[y] = (png_byte *)malloc(rowbytes);
-        if (!row_pointers[y]) {
-            for (int i = 0; i < y; i++)
-                free(row_pointers[i]);
-            free(row_pointers);
-            png_destroy_read_struct(&png, &info, NULL);
-            fclose(fp);
-            return 0;
+    png_set_read_fn(png, &reader, mem_read_fn);
+    png_set_sig_bytes(png, 8);
+    set_limits(png);
+
+    png_read_info(png, info);
+    HARNESS_STAGE(STAGE_INFO);
+
+    // img attributes
+    png_uint_32 width = png_get_image_width(png, info);
+    png_uint_32 height = png_get_image_height(png, info);
+    png_byte interlace = png_get_interlace_type(png, info);
+
+    set_transforms(png, info, xforms);
+
+    // png_read_image turns interlace handling on by itself (with a warning)
+    int passes = 1;
+    if (config.streaming || (xforms & XFORM_INTERLACE))
+        passes = png_set_interlace_handling(png);
+
+    png_read_update_info(png, info);
+    HARNESS_STAGE(STAGE_TRANSFORMS);
+
+    size_t rowbytes = png_get_rowbytes(png, info);
+
+    // the encoder is fed RGBA8 rows, skip it if the transforms produced anything else
+    if (sink != SINK_NONE && rowbytes == (size_t)width * 4)
+        writer_open(&writer, sink, width, height);
+    HARNESS_STAGE(STAGE_ENCODE);
+
+    if (config.streaming) {
+        // one reused row, or one slab when interlace passes revisit rows
+        int slab = interlace != PNG_INTERLACE_NONE;
+        row_buf = (png_bytep)heap_malloc(slab ? rowbytes * height : rowbytes);
+        if (!row_buf)
+            png_error(png, "out of memory");
+
+        for (int pass = 0; pass < passes; pass++) {
+            for (png_uint_32 y = 0; y < height; y++) {
+                png_bytep row = slab ? row_buf + rowbytes * y : row_buf;
+                png_read_row(png, row, NULL);
+                if (!slab)
+                    writer_rows(&writer, &row, 1);
+            }
         }
-    }
 
-    png_read_image(png, row_pointers);
+        // non-interlaced rows are re-encoded as they arrive, so IMAGE includes that encode
+        HARNESS_STAGE(STAGE_IMAGE);
+        if (slab) {
+            for (png_uint_32 y = 0; y < height; y++) {
+                png_bytep row = row_buf + rowbytes * y;
+                writer_rows(&writer, &row, 1);
+            }
+        }
+        HARNESS_STAGE(STAGE_ENCODE);
+    } else {
+        // img data
+        row_pointers = (png_bytep *)heap_malloc(height * sizeof(png_bytep));
+        if (!row_pointers)
+            png_error(png, "out of memory");
+        memset(row_pointers, 0, height * sizeof(png_bytep));
+
+        for (png_uint_32 y = 0; y < height; y++) {
+            row_pointers[y] = (png_byte *)heap_malloc(rowbytes);
+            if (!row_pointers[y])
+                png_error(png, "out of memory");
+            rows_allocated = y + 1;
+        }
+
+        png_read_image(png, row_pointers);
+        HARNESS_STAGE(STAGE_IMAGE);
+        writer_rows(&writer, row_pointers, height);
+        HARNESS_STAGE(STAGE_ENCODE);
+    }
 
     png_read_end(png, info);
+    HARNESS_STAGE(STAGE_END);
 
-    fclose(fp);
+    writer_finish(&writer, sink, output_file);
+    HARNESS_STAGE(STAGE_ENCODE);
 
-    if (output_file) {
-        FILE *out = fopen(output_file, "wb");
-        if (out) {
-            png_structp wpng = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-            png_infop winfo = png_create_info_struct(wpng);
-
-            if (wpng && winfo) {
-                if (setjmp(png_jmpbuf(wpng))) {
-                    png_destroy_write_struct(&wpng, &winfo);
-                    fclose(out);
-                } else {
-                    png_init_io(wpng, out);
-
-                    png_set_IHDR(wpng, winfo,
-                                 width, height, 8,
-                                 PNG_COLOR_TYPE_RGBA,
-                                 PNG_INTERLACE_NONE,
-                                 PNG_COMPRESSION_TYPE_BASE,
-                                 PNG_FILTER_TYPE_BASE);
-
-                    png_write_info(wpng, winfo);
-                    png_write_image(wpng, row_pointers);
-                    png_write_end(wpng, winfo);
-
-                    png_destroy_write_struct(&wpng, &winfo);
-                    fclose(out);
+    free_rows(row_pointers, rows_allocated);
+    heap_free(row_buf);
+
+    png_destroy_read_struct(&png, &info, NULL);
+
+    return 0;
+}
+
+// push-mode decode state, reached from the progressive callbacks through png_get_progressive_ptr
+typedef struct {
+    png_writer_t writer;
+    int sink;
+    unsigned xforms;
+    int done;  // IEND seen
+} push_state_t;
+
+static void push_info_fn(png_structp png, png_infop info) {
+    push_state_t *state = (push_state_t *)png_get_progressive_ptr(png);
+    HARNESS_STAGE(STAGE_INFO);
+
+    png_uint_32 width = png_get_image_width(png, info);
+    png_uint_32 height = png_get_image_height(png, info);
+    png_byte interlace = png_get_interlace_type(png, info);
+
+    // no png_set_interlace_handling unless asked for: interlaced passes arrive as
+    // reduced rows, so nothing ever holds more than libpng's own row buffer
+    set_transforms(png, info, state->xforms);
+    if (state->xforms & XFORM_INTERLACE)
+        png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+    HARNESS_STAGE(STAGE_TRANSFORMS);
+
+    if (state->sink != SINK_NONE && interlace == PNG_INTERLACE_NONE &&
+        png_get_rowbytes(png, info) == (size_t)width * 4)
+        writer_open(&state->writer, state->sink, width, height);
+    HARNESS_STAGE(STAGE_ENCODE);
+}
+
+static void push_row_fn(png_structp png, png_bytep row, png_uint_32 row_num, int pass) {
+    push_state_t *state = (push_state_t *)png_get_progressive_ptr(png);
+    (void)row_num;
+    (void)pass;
+    // with interlace handling, rows a pass does not touch come through as NULL
+    if (row)
+        writer_rows(&state->writer, &row, 1);
+}
+
+static void push_end_fn(png_structp png, png_infop info) {
+    push_state_t *state = (push_state_t *)png_get_progressive_ptr(png);
+    (void)info;
+    // rows are re-encoded as they arrive, so IMAGE includes that encode
+    HARNESS_STAGE(STAGE_IMAGE);
+    state->done = 1;
+}
+
+// offset just past the IEND chunk, or size if the chunk walk never reaches one
+static size_t png_stream_end(const uint8_t *data, size_t size) {
+    size_t pos = 8;
+    while (size - pos >= 12) {
+        uint32_t len = ((uint32_t)data[pos] << 24) | ((uint32_t)data[pos + 1] << 16) |
+                       ((uint32_t)data[pos + 2] << 8) | data[pos + 3];
+        if (len > size - pos - 12)
+            break;
+        pos += 12 + (size_t)len;
+        if (!memcmp(data + pos - len - 8, "IEND", 4))
+            return pos;
+    }
+    return size;
+}
+
+// fragment sizes for the push path. bytes after IEND are the schedule, one byte
+// per fragment and cycled; without a trailer it is seeded from the stream's crc.
+// a byte maps log-uniformly onto 1..3969 so chunk headers get split too
+typedef struct {
+    const uint8_t *bytes;
+    size_t count;
+    size_t next;
+    uint32_t seed;
+} feed_schedule_t;
+
+static size_t next_fragment(feed_schedule_t *schedule) {
+    if (config.feed_bytes)
+        return config.feed_bytes;
+
+    unsigned b;
+    if (schedule->count) {
+        b = schedule->bytes[schedule->next++ % schedule->count];
+    } else {
+        schedule->seed ^= schedule->seed << 13;
+        schedule->seed ^= schedule->seed >> 17;
+        schedule->seed ^= schedule->seed << 5;
+        b = schedule->seed & 0xff;
+    }
+    return 1 + ((size_t)(b & 0x1f) << (b >> 5));
+}
+
+// decode one png by feeding its first end bytes to png_process_data in
+// fragments, as a network decoder would. rows are consumed in the row callback
+// with O(row) memory
+static int decode_png_progressive(const uint8_t *data, size_t end, const char *output_file,
+                                  unsigned xforms, feed_schedule_t *schedule) {
+    if (end < 8 || png_sig_cmp((png_const_bytep)data, 0, 8))
+        return 0;
+
+    push_state_t state;
+    memset(&state, 0, sizeof(state));
+    state.sink = resolve_sink(output_file);
+    state.xforms = xforms;
+
+    png_structp png = CREATE_READ_STRUCT();
+    if (!png)
+        return 0;
+
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return 0;
+    }
+
+    if (setjmp(png_jmpbuf(png))) {
+        writer_close(&state.writer);
+        png_destroy_read_struct(&png, &info, NULL);
+        return 0;
+    }
+
+    set_limits(png);
+    png_set_progressive_read_fn(png, &state, push_info_fn, push_row_fn, push_end_fn);
+
+    // the signature goes through png_process_data too, so it can be split as well
+    size_t pos = 0;
+    while (pos < end && !state.done) {
+        size_t len = next_fragment(schedule);
+        if (len > end - pos)
+            len = end - pos;
+        png_process_data(png, info, (png_bytep)data + pos, len);
+        pos += len;
+    }
+
+    // a truncated stream is not an error in push mode, it just never reaches IEND
+    if (state.done) {
+        HARNESS_STAGE(STAGE_END);
+        writer_finish(&state.writer, state.sink, output_file);
+        HARNESS_STAGE(STAGE_ENCODE);
+    }
+    writer_close(&state.writer);
+
+    png_destroy_read_struct(&png, &info, NULL);
+
+    return 0;
+}
+
+// decode through the simplified API into one caller-provided buffer. it has
+// no transform switches, so the XFORM_* bits pick the closest output format
+static int decode_png_simplified(const uint8_t *data, size_t size, const char *output_file,
+                                 unsigned xforms) {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+
+    // errors are reported through the return value, libpng longjmps internally
+    if (!png_image_begin_read_from_memory(&image, data, size))
+        return 0;
+    HARNESS_STAGE(STAGE_INFO);
+
+    if ((config.max_dimension &&
+         (image.width > config.max_dimension || image.height > config.max_dimension)) ||
+        (config.max_pixels && (uint64_t)image.width * image.height > config.max_pixels)) {
+        png_image_free(&image);
+        return 0;
+    }
+
+    png_uint_32 format = PNG_FORMAT_RGBA;
+    if (xforms & XFORM_GAMMA)
+        format |= PNG_FORMAT_FLAG_LINEAR;       // 16-bit linear, premultiplied
+    if (xforms & XFORM_BACKGROUND)
+        format &= ~PNG_FORMAT_FLAG_ALPHA;       // composited onto the background
+    if (xforms & XFORM_INVERT)
+        format &= ~PNG_FORMAT_FLAG_COLOR;       // gray
+    if (xforms & XFORM_QUANTIZE)
+        format |= PNG_FORMAT_FLAG_COLORMAP;
+#ifdef PNG_FORMAT_BGR_SUPPORTED
+    if (xforms & XFORM_BGR)
+        format |= PNG_FORMAT_FLAG_BGR;
+#endif
+#ifdef PNG_FORMAT_AFIRST_SUPPORTED
+    if (xforms & XFORM_ALPHA_MODE)
+        format |= PNG_FORMAT_FLAG_AFIRST;
+#endif
+    image.format = format;
+
+    // png_image_* has no allocator hook, so the peak only sees the harness buffers
+#ifdef HARNESS_STAGE_HOOK
+    harness_heap_partial = 1;
+#endif
+
+    int sink = resolve_sink(output_file);
+    size_t stride = PNG_IMAGE_ROW_STRIDE(image) * PNG_IMAGE_PIXEL_COMPONENT_SIZE(image.format);
+    png_bytep buffer = (png_bytep)heap_malloc(PNG_IMAGE_SIZE(image));
+    png_bytep colormap = NULL;
+    if (format & PNG_FORMAT_FLAG_COLORMAP)
+        colormap = (png_bytep)heap_malloc(PNG_IMAGE_COLORMAP_SIZE(image));
+    if (!buffer || ((format & PNG_FORMAT_FLAG_COLORMAP) && !colormap)) {
+        heap_free(buffer);
+        heap_free(colormap);
+        png_image_free(&image);
+        return 0;
+    }
+    HARNESS_STAGE(STAGE_TRANSFORMS);
+
+    png_color background = { 0x80, 0x80, 0x80 };
+    int ok = png_image_finish_read(&image, &background, buffer, 0, colormap);
+    HARNESS_STAGE(STAGE_IMAGE);
+
+    if (ok) {
+        HARNESS_STAGE(STAGE_END);
+        // the encoder is fed RGBA8 rows, every other format skips it
+        if (sink != SINK_NONE && format == PNG_FORMAT_RGBA) {
+            png_writer_t writer;
+            if (writer_open(&writer, sink, image.width, image.height)) {
+                for (png_uint_32 y = 0; y < image.height; y++) {
+                    png_bytep row = buffer + stride * y;
+                    writer_rows(&writer, &row, 1);
                 }
+                writer_finish(&writer, sink, output_file);
+            }
+            writer_close(&writer);
+        }
+        HARNESS_STAGE(STAGE_ENCODE);
+    }
+
+    png_image_free(&image);
+    heap_free(buffer);
+    heap_free(colormap);
+    return 0;
+}
+
+// the input's trailer (bytes after IEND) picks the transforms (first two bytes,
+// little-endian) and the push fragment schedule (the rest). inputs without one
+// get both from the stream's crc, so every seed lands somewhere in the matrix
+static int decode_input(const uint8_t *data, size_t size, const char *output_file) {
+    unsigned xforms = config.transforms;
+    size_t end = size;
+    feed_schedule_t schedule = { NULL, 0, 0, 0 };
+
+    if ((config.progressive || xforms == XFORM_INPUT) &&
+        size >= 8 && !png_sig_cmp((png_const_bytep)data, 0, 8)) {
+        end = png_stream_end(data, size);
+        schedule.bytes = data + end;
+        schedule.count = size - end;
+        schedule.seed = (uint32_t)crc32(0L, data, (uInt)end) | 1;
+
+        if (xforms == XFORM_INPUT) {
+            if (schedule.count >= 2) {
+                xforms = schedule.bytes[0] | (unsigned)schedule.bytes[1] << 8;
+                schedule.bytes += 2;
+                schedule.count -= 2;
             } else {
-                if (wpng) png_destroy_write_struct(&wpng, &winfo);
-                fclose(out);
+                xforms = schedule.seed >> 16;
             }
         }
     }
+    xforms &= XFORM_ALL;
 
-    for (int y = 0; y < height; y++)
-        free(row_pointers[y]);
-    free(row_pointers);
+    if (xforms & XFORM_SIMPLIFIED)
+        return decode_png_simplified(data, end, output_file, xforms);
+    if (config.progressive)
+        return decode_png_progressive(data, end, output_file, xforms, &schedule);
+    return decode_png(data, size, output_file, xforms);
+}
 
-    png_destroy_read_struct(&png, &info, NULL);
+// libFuzzer-style entry points, also driven by the AFL++ persistent loop below
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void)argc;
+    (void)argv;
+    load_config();
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    decode_input(data, size, NULL);
+    return 0;
+}
+
+#ifndef HARNESS_NO_MAIN
+
+#ifdef HARNESS_PERSISTENT
+
+// fallbacks so the persistent build also runs outside afl-clang-fast (reads stdin once)
+#ifndef __AFL_FUZZ_TESTCASE_LEN
+static ssize_t fuzz_len;
+static unsigned char fuzz_buf[1 << 20];
+#define __AFL_FUZZ_TESTCASE_LEN fuzz_len
+#define __AFL_FUZZ_TESTCASE_BUF fuzz_buf
+#define __AFL_FUZZ_INIT() void sync(void)
+#define __AFL_LOOP(x) \
+    ((fuzz_len = read(0, fuzz_buf, sizeof(fuzz_buf))) > 0 ? 1 : 0)
+#define __AFL_INIT() sync()
+#endif
+
+__AFL_FUZZ_INIT();
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    // input-independent setup goes above this line so forks inherit it
+    load_config();
+
+    __AFL_INIT();
+
+    // must be read after __AFL_INIT, the buffer is shared memory
+    unsigned char *buf = __AFL_FUZZ_TESTCASE_BUF;
+
+    while (__AFL_LOOP(10000)) {
+        size_t len = __AFL_FUZZ_TESTCASE_LEN;
+        LLVMFuzzerTestOneInput(buf, len);
+    }
 
     return 0;
 }
+
+#else
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input.png> [output.png]\n", argv[0]);
+        return 0;
+    }
+
+    const char *input_file = argv[1];
+    const char *output_file = (argc >= 3) ? argv[2] : NULL;
+
+    load_config();
+
+    FILE *fp = fopen(input_file, "rb");
+    if (!fp) {
+        return 0;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return 0;
+    }
+
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (!data) {
+        fclose(fp);
+        return 0;
+    }
+    if (fread(data, 1, size, fp) != (size_t)size) {
+        free(data);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+
+    decode_input(data, size, output_file);
+
+    free(data);
+    return 0;
+}
+
+#endif /* HARNESS_PERSISTENT */
+
+#endif /* HARNESS_NO_MAIN */
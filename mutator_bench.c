@@ -0,0 +1,223 @@
+// microbenchmark for png_mutator.c: ns per afl_custom_fuzz call over a seed directory,
+// plus the share of mutated outputs that still get through png_read_info and
+// through a full decode (IDAT crcs are only checked once rows are read)
+// usage: mutator-bench <seed_dir> [iterations] [validate_count]
+// build with -DNO_QUEUE_GET to benchmark mutators that predate afl_custom_queue_get
+
+#include <dirent.h>
+#include <png.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void *afl_custom_init(void *afl, unsigned int seed);
+size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size,
+                       uint8_t **out_buf, uint8_t *add_buf,
+                       size_t add_buf_size, size_t max_size);
+uint8_t afl_custom_queue_get(void *data, const uint8_t *filename);
+void afl_custom_deinit(void *data);
+
+#define MAX_SEEDS 4096
+#define MAX_SIZE (1024 * 1024)
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} seed_t;
+
+static seed_t seeds[MAX_SEEDS];
+static int seed_count;
+
+static void load_seeds(const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        perror(dir_path);
+        exit(1);
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) && seed_count < MAX_SEEDS) {
+        if (entry->d_name[0] == '.') continue;
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        FILE *fp = fopen(path, "rb");
+        if (!fp) continue;
+
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (size > 0 && size <= MAX_SIZE) {
+            uint8_t *data = (uint8_t *)malloc(size);
+            if (data && fread(data, 1, size, fp) == (size_t)size) {
+                seeds[seed_count].data = data;
+                seeds[seed_count].size = size;
+                seed_count++;
+            } else {
+                free(data);
+            }
+        }
+        fclose(fp);
+    }
+    closedir(dir);
+}
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} mem_reader_t;
+
+static void mem_read_fn(png_structp png, png_bytep out, png_size_t len) {
+    mem_reader_t *reader = (mem_reader_t *)png_get_io_ptr(png);
+    if (len > reader->size - reader->pos)
+        png_error(png, "read past end of input");
+    memcpy(out, reader->data + reader->pos, len);
+    reader->pos += len;
+}
+
+static void silent_warning(png_structp png, png_const_charp msg) {
+    (void)png;
+    (void)msg;
+}
+
+static int crc_rejected;
+
+static void silent_error(png_structp png, png_const_charp msg) {
+    if (strstr(msg, "CRC"))
+        crc_rejected = 1;
+    png_longjmp(png, 1);
+}
+
+// how far libpng gets on data: 0 = rejected, 1 = png_read_info, 2 = png_read_end
+static int decode_stage(const uint8_t *data, size_t size) {
+    if (size < 8 || png_sig_cmp((png_const_bytep)data, 0, 8))
+        return 0;
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL,
+                                             silent_error, silent_warning);
+    if (!png) return 0;
+    png_infop info = png_create_info_struct(png);
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return 0;
+    }
+
+    mem_reader_t reader = { data, size, 0 };
+    png_bytep volatile row = NULL;
+    volatile int stage = 0;
+
+    if (setjmp(png_jmpbuf(png))) {
+        free(row);
+        png_destroy_read_struct(&png, &info, NULL);
+        return stage;
+    }
+
+    png_set_read_fn(png, &reader, mem_read_fn);
+    png_set_user_limits(png, 4096, 4096);
+    png_read_info(png, info);
+    stage = 1;
+
+    int passes = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+    row = (png_bytep)malloc(png_get_rowbytes(png, info));
+    if (!row)
+        png_error(png, "out of memory");
+
+    png_uint_32 height = png_get_image_height(png, info);
+    for (int pass = 0; pass < passes; pass++)
+        for (png_uint_32 y = 0; y < height; y++)
+            png_read_row(png, row, NULL);
+    png_read_end(png, info);
+    stage = 2;
+
+    free(row);
+    png_destroy_read_struct(&png, &info, NULL);
+    return stage;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <seed_dir> [iterations] [validate_count]\n", argv[0]);
+        return 1;
+    }
+
+    long iterations = (argc >= 3) ? atol(argv[2]) : 1000000;
+    long validate = (argc >= 4) ? atol(argv[3]) : 100000;
+    load_seeds(argv[1]);
+    if (seed_count == 0) {
+        fprintf(stderr, "no seeds in %s\n", argv[1]);
+        return 1;
+    }
+
+    void *state = afl_custom_init(NULL, 1234);
+    size_t total_bytes = 0;
+
+    // afl fuzzes one queue entry many times in a row, so stay on a seed for a while
+    long per_seed = iterations / seed_count;
+    if (per_seed < 1) per_seed = 1;
+
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        seed_t *seed = &seeds[(i / per_seed) % seed_count];
+#ifndef NO_QUEUE_GET
+        if (i % per_seed == 0)
+            afl_custom_queue_get(state, NULL);
+#endif
+        uint8_t *out = NULL;
+        // afl hands a second queue entry to splice with
+        seed_t *donor = &seeds[(i / per_seed + 1) % seed_count];
+        total_bytes += afl_custom_fuzz(state, seed->data, seed->size, &out,
+                                       donor->data, donor->size, MAX_SIZE);
+    }
+    double elapsed = now_ns() - start;
+
+    // untimed: how far the outputs get into libpng
+    long passed_info = 0, passed_decode = 0, failed_crc = 0;
+    long per_seed_validate = validate / seed_count;
+    if (per_seed_validate < 1) per_seed_validate = 1;
+    for (long i = 0; i < validate; i++) {
+        seed_t *seed = &seeds[(i / per_seed_validate) % seed_count];
+#ifndef NO_QUEUE_GET
+        if (i % per_seed_validate == 0)
+            afl_custom_queue_get(state, NULL);
+#endif
+        uint8_t *out = NULL;
+        seed_t *donor = &seeds[(i / per_seed_validate + 1) % seed_count];
+        size_t out_size = afl_custom_fuzz(state, seed->data, seed->size, &out,
+                                          donor->data, donor->size, MAX_SIZE);
+        crc_rejected = 0;
+        int stage = decode_stage(out, out_size);
+        failed_crc += crc_rejected;
+        passed_info += stage >= 1;
+        passed_decode += stage >= 2;
+    }
+
+    afl_custom_deinit(state);
+
+    printf("seeds:          %d\n", seed_count);
+    printf("iterations:     %ld\n", iterations);
+    printf("ns/mutation:    %.1f\n", elapsed / iterations);
+    printf("mutations/sec:  %.0f\n", iterations / (elapsed / 1e9));
+    printf("avg output:     %.1f bytes\n", (double)total_bytes / iterations);
+    if (validate > 0) {
+        printf("png_read_info:  %.1f%% of %ld outputs pass\n",
+               100.0 * passed_info / validate, validate);
+        printf("full decode:    %.1f%% of %ld outputs pass\n",
+               100.0 * passed_decode / validate, validate);
+        printf("crc rejects:    %.1f%% of %ld outputs\n",
+               100.0 * failed_crc / validate, validate);
+    }
+
+    for (int i = 0; i < seed_count; i++)
+        free(seeds[i].data);
+    return 0;
+}
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
+#include <zlib.h>
 
 static const uint8_t PNG_SIGNATURE[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
 
@@ -9,18 +11,218 @@ static const uint8_t PNG_SIGNATURE[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1
 #define CHUNK_PLTE 0x504C5445
 #define CHUNK_IDAT 0x49444154
 #define CHUNK_IEND 0x49454E44
+#define CHUNK_tRNS 0x74524E53
+#define CHUNK_bKGD 0x624B4744
+#define CHUNK_hIST 0x68495354
+#define CHUNK_gAMA 0x67414D41
+#define CHUNK_iCCP 0x69434350
+#define CHUNK_sPLT 0x73504C54
+#define CHUNK_tEXt 0x74455874
+#define CHUNK_zTXt 0x7A545874
+#define CHUNK_iTXt 0x69545874
 
+// one entry of the per-testcase chunk table
 typedef struct {
+    size_t offset;      // start of the length field
     uint32_t length;
     uint32_t type;
-    uint8_t *data;
-    uint32_t crc;
+    uint8_t crc_valid;
 } png_chunk_t;
+
+// structural mutations repair the chunk crc (when the parent's was valid) so
+// libpng gets past png_crc_finish; only STRAT_CRC_CORRUPT breaks it on purpose
+enum {
+    STRAT_CRC_CORRUPT,
+    STRAT_LENGTH,
+    STRAT_IHDR_FLIP,
+    STRAT_DUPLICATE,
+    STRAT_TYPE,
+    STRAT_IDAT_BYTE,
+    STRAT_REMOVE,
+    STRAT_BYTE_FLIP,
+    STRAT_SCANLINE,
+    STRAT_GENERATE,
+    STRAT_SPLICE,     // last: left out of scheduling while there is no add_buf
+    STRAT_COUNT
+};
+
+static const char *strategy_names[STRAT_COUNT] = {
+    "crc_corrupt", "length", "ihdr_flip", "duplicate", "type",
+    "idat_byte", "remove", "byte_flip", "scanline", "generate", "splice",
+};
+
+// prior weights: used until the first new path, and for the exploration draws after
+static const int strategy_weights[STRAT_COUNT] = {
+    1,  // crc corrupt
+    3,  // length
+    2,  // ihdr flip
+    2,  // duplicate
+    2,  // type
+    3,  // idat byte
+    2,  // remove
+    3,  // byte flip
+    4,  // scanline
+    1,  // generate
+    3,  // splice
+};
+
+// one filtered scanline inside the inflated IDAT stream
+typedef struct {
+    size_t offset;      // filter-type byte
+    uint32_t length;    // pixel bytes after it
+} png_row_t;
+
+// inflated IDAT data larger than this is not cached, the scanline strategy skips
+// it (re-deflating runs at roughly 30 ns/byte even at level 1)
+#define MAX_RAW_SIZE (1u << 20)
+
+// one piece of a spliced child: a whole chunk (or the signature / trailing bytes)
+// in either parent, copied once the child's size is known
+typedef struct {
+    const uint8_t *src;
+    size_t size;
+} splice_ref_t;
+
 typedef struct {
+    // grow-only output buffer, handed back to afl as out_buf
     uint8_t *mutated_data;
     size_t mutated_size;
+    size_t mutated_capacity;
+
+    // chunk table for the queue entry being fuzzed, dropped in afl_custom_queue_get
+    png_chunk_t *chunks;
+    int chunk_count;
+    int chunk_capacity;
+    int first_idat;       // index into chunks, -1 if none
+    int first_removable;  // first chunk that is neither IHDR nor IEND, -1 if none
+    int index_valid;
+    const uint8_t *index_buf;
+    size_t index_size;
+
+    // inflated IDAT stream and its scanlines, cached alongside the chunk table
+    int raw_state;        // 0 = not built, 1 = usable, -1 = not inflatable
+    uint8_t *raw;
+    size_t raw_size;
+    size_t raw_capacity;
+    png_row_t *rows;
+    size_t row_count;
+    size_t row_capacity;
+
+    // add_buf's chunk table and the splice assembly list, rebuilt per splice
+    png_chunk_t *donor_chunks;
+    int donor_count;
+    int donor_capacity;
+    splice_ref_t *refs;
+    int ref_count;
+    int ref_capacity;
+
+    // scanlines of the png being generated
+    uint8_t *gen_raw;
+    size_t gen_capacity;
+
+    // zlib streams are set up once in afl_custom_init and reset per use
+    z_stream inflater;
+    z_stream deflater;
+    int zlib_ready;
+
+    // per-instance xorshift64* state, seeded from afl in afl_custom_init
+    uint64_t rng;
+
+    // scheduler counters; a new queue entry is credited to the strategy named in its filename
+    int last_strategy;
+    uint64_t total_calls;
+    uint64_t calls[STRAT_COUNT];
+    uint64_t new_paths[STRAT_COUNT];
+    uint64_t saves[STRAT_COUNT];     // every describe call: new paths + crashes + hangs
+    char stats_path[4096];
 } afl_state_t;
 
+#define DESCRIBE_PREFIX "png:"
+#define STATS_INTERVAL (1u << 16)
+
+static uint32_t next_rand(afl_state_t *state) {
+    uint64_t x = state->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    state->rng = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+// uniform in [0, bound) without a division
+static uint32_t rand_below(afl_state_t *state, uint64_t bound) {
+    return (uint32_t)(((uint64_t)next_rand(state) * bound) >> 32);
+}
+
+// splice needs a second png in add_buf; afl passes none until the queue has two entries
+static int pick_weighted(afl_state_t *state, int can_splice) {
+    int count = can_splice ? STRAT_COUNT : STRAT_SPLICE;
+    int total = 0;
+    for (int i = 0; i < count; i++)
+        total += strategy_weights[i];
+    int r = rand_below(state, total);
+    for (int i = 0; i < count; i++) {
+        if (r < strategy_weights[i]) return i;
+        r -= strategy_weights[i];
+    }
+    return STRAT_BYTE_FLIP;
+}
+
+// ucb1 over new paths per call. new paths are rare (~1e-5 per call), so rates
+// are rescaled by the best arm's rate; otherwise the exploration term swamps
+// them and ucb degrades into round robin. one draw in 16 uses the prior weights
+static int pick_strategy(afl_state_t *state, int can_splice) {
+    int count = can_splice ? STRAT_COUNT : STRAT_SPLICE;
+    double best_rate = 0;
+    for (int i = 0; i < count; i++) {
+        if (state->calls[i] == 0) return i;
+        double rate = (double)state->new_paths[i] / state->calls[i];
+        if (rate > best_rate) best_rate = rate;
+    }
+    if (best_rate == 0 || rand_below(state, 16) == 0)
+        return pick_weighted(state, can_splice);
+
+    double log_total = log((double)state->total_calls);
+    int best = 0;
+    double best_score = -1;
+    for (int i = 0; i < count; i++) {
+        double rate = (double)state->new_paths[i] / state->calls[i] / best_rate;
+        double score = rate + sqrt(2.0 * log_total / state->calls[i]);
+        if (score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// rewrite the stats file in one go so readers never see a half-written table
+static void write_stats(afl_state_t *state) {
+    if (!state->stats_path[0]) return;
+
+    char tmp_path[sizeof(state->stats_path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", state->stats_path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) return;
+
+    fprintf(fp, "# total_calls %llu\n", (unsigned long long)state->total_calls);
+    fprintf(fp, "%-12s %6s %12s %10s %8s %12s\n",
+            "strategy", "weight", "calls", "new_paths", "crashes", "paths_per_1M");
+    for (int i = 0; i < STRAT_COUNT; i++) {
+        uint64_t crashes = state->saves[i] > state->new_paths[i] ?
+                           state->saves[i] - state->new_paths[i] : 0;
+        double per_million = state->calls[i] ?
+                             1e6 * state->new_paths[i] / state->calls[i] : 0;
+        fprintf(fp, "%-12s %6d %12llu %10llu %8llu %12.2f\n",
+                strategy_names[i], strategy_weights[i],
+                (unsigned long long)state->calls[i],
+                (unsigned long long)state->new_paths[i],
+                (unsigned long long)crashes, per_million);
+    }
+    fclose(fp);
+    rename(tmp_path, state->stats_path);
+}
+
 static uint32_t read_be32(const uint8_t *data) {
     return ((uint32_t)data[0] << 24) |
            ((uint32_t)data[1] << 16) |
@@ -41,226 +243,1063 @@ static int is_png(const uint8_t *data, size_t size) {
     return memcmp(data, PNG_SIGNATURE, 8) == 0;
 }
 
+// chunk crc covers type + data; zlib's crc32 is table-driven and braided
+static uint32_t chunk_crc(const uint8_t *chunk_type, uint32_t length) {
+    return (uint32_t)crc32(0L, chunk_type, 4 + length);
+}
+
+// rewrite the crc of the chunk whose length field sits at offset
+static void fix_crc(uint8_t *out, size_t offset, uint32_t length) {
+    write_be32(out + offset + 8 + length, chunk_crc(out + offset + 4, length));
+}
+
+// single-byte edit at pos inside a chunk whose crc was valid. crc is linear, so
+// shift the byte delta past the rest of the chunk (crc32_combine, O(log n))
+// instead of rehashing a possibly multi-KB IDAT
+static void patch_crc(uint8_t *out, const png_chunk_t *chunk, size_t pos, uint8_t old_byte) {
+    // below this size a straight rehash is cheaper than crc32_combine's matrix math
+    if (chunk->length < 512) {
+        fix_crc(out, chunk->offset, chunk->length);
+        return;
+    }
+    size_t crc_offset = chunk->offset + 8 + chunk->length;
+    uint8_t zero = 0, diff = out[pos] ^ old_byte;
+    uLong delta = crc32(0L, &diff, 1) ^ crc32(0L, &zero, 1);
+    delta = crc32_combine(delta, 0L, (z_off_t)(crc_offset - pos - 1));
+    write_be32(out + crc_offset, read_be32(out + crc_offset) ^ (uint32_t)delta);
+}
+
+static int ensure_output(afl_state_t *state, size_t size) {
+    if (size <= state->mutated_capacity) return 1;
+    size_t capacity = state->mutated_capacity ? state->mutated_capacity : 4096;
+    while (capacity < size)
+        capacity *= 2;
+    uint8_t *data = (uint8_t *)realloc(state->mutated_data, capacity);
+    if (!data) return 0;
+    state->mutated_data = data;
+    state->mutated_capacity = capacity;
+    return 1;
+}
+
+// next free slot of a grow-only chunk table, NULL if out of memory
+static png_chunk_t *push_chunk(png_chunk_t **chunks, int *count, int *capacity) {
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 32;
+        png_chunk_t *table = (png_chunk_t *)realloc(*chunks, grown * sizeof(png_chunk_t));
+        if (!table) return NULL;
+        *chunks = table;
+        *capacity = grown;
+    }
+    return &(*chunks)[(*count)++];
+}
+
+// walk the chunk list once per queue entry. afl restores buf between calls of
+// one stage, and every offset is bounded by buf_size, so a stale table can only
+// weaken a mutation, never write out of bounds
+static void index_chunks(afl_state_t *state, const uint8_t *buf, size_t buf_size) {
+    if (state->index_valid && buf == state->index_buf && buf_size == state->index_size)
+        return;
+
+    state->chunk_count = 0;
+    state->raw_state = 0;
+    state->first_idat = -1;
+    state->first_removable = -1;
+    state->index_valid = 1;
+    state->index_buf = buf;
+    state->index_size = buf_size;
+
+    size_t offset = 8;
+    while (offset + 12 <= buf_size) {
+        uint32_t length = read_be32(buf + offset);
+        if (length > buf_size - offset - 12) break;
+
+        png_chunk_t *chunk = push_chunk(&state->chunks, &state->chunk_count,
+                                        &state->chunk_capacity);
+        if (!chunk) break;
+        chunk->offset = offset;
+        chunk->length = length;
+        chunk->type = read_be32(buf + offset + 4);
+        chunk->crc_valid = chunk_crc(buf + offset + 4, length) ==
+                           read_be32(buf + offset + 8 + length);
+
+        if (chunk->type == CHUNK_IDAT && state->first_idat < 0)
+            state->first_idat = state->chunk_count - 1;
+        if (chunk->type != CHUNK_IHDR && chunk->type != CHUNK_IEND &&
+            state->first_removable < 0)
+            state->first_removable = state->chunk_count - 1;
+
+        offset += 12 + length;
+    }
+}
+
+// adam7 pass geometry: x start, y start, x step, y step
+static const uint8_t adam7[7][4] = {
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+    {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2},
+};
+
+static int add_row(afl_state_t *state, size_t offset, uint32_t length) {
+    if (state->row_count == state->row_capacity) {
+        size_t capacity = state->row_capacity ? state->row_capacity * 2 : 256;
+        png_row_t *rows = (png_row_t *)realloc(state->rows, capacity * sizeof(png_row_t));
+        if (!rows) return 0;
+        state->rows = rows;
+        state->row_capacity = capacity;
+    }
+    state->rows[state->row_count].offset = offset;
+    state->rows[state->row_count].length = length;
+    state->row_count++;
+    return 1;
+}
+
+// lay out the scanlines the IHDR implies; returns the expected inflated size
+static size_t layout_rows(afl_state_t *state, const uint8_t *ihdr) {
+    uint32_t width = read_be32(ihdr);
+    uint32_t height = read_be32(ihdr + 4);
+    uint8_t depth = ihdr[8], color = ihdr[9], interlace = ihdr[12];
+
+    int channels;
+    switch (color) {
+        case 0: case 3: channels = 1; break;
+        case 2: channels = 3; break;
+        case 4: channels = 2; break;
+        case 6: channels = 4; break;
+        default: return 0;
+    }
+    uint64_t bits = (uint64_t)channels * depth;
+    if (bits == 0 || width == 0 || height == 0) return 0;
+
+    state->row_count = 0;
+    size_t offset = 0;
+    int passes = interlace ? 7 : 1;
+    for (int pass = 0; pass < passes; pass++) {
+        uint32_t x0 = 0, y0 = 0, dx = 1, dy = 1;
+        if (interlace) {
+            x0 = adam7[pass][0]; y0 = adam7[pass][1];
+            dx = adam7[pass][2]; dy = adam7[pass][3];
+        }
+        if (width <= x0 || height <= y0) continue;
+        uint64_t pass_width = (width - x0 + dx - 1) / dx;
+        uint32_t pass_height = (height - y0 + dy - 1) / dy;
+        uint64_t row_bytes = (pass_width * bits + 7) / 8;
+
+        for (uint32_t y = 0; y < pass_height; y++) {
+            if (offset + 1 + row_bytes > MAX_RAW_SIZE) return 0;
+            if (!add_row(state, offset, (uint32_t)row_bytes)) return 0;
+            offset += 1 + row_bytes;
+        }
+    }
+    return offset;
+}
+
+// inflate every IDAT of the current entry into state->raw, once per queue entry
+static int load_scanlines(afl_state_t *state, const uint8_t *buf) {
+    if (state->raw_state) return state->raw_state > 0;
+    state->raw_state = -1;
+
+    png_chunk_t *chunks = state->chunks;
+    if (!state->zlib_ready || state->first_idat < 0 ||
+        chunks[0].type != CHUNK_IHDR || chunks[0].length != 13)
+        return 0;
+
+    size_t expected = layout_rows(state, buf + chunks[0].offset + 8);
+    if (expected == 0) return 0;
+
+    if (expected > state->raw_capacity) {
+        uint8_t *raw = (uint8_t *)realloc(state->raw, expected);
+        if (!raw) return 0;
+        state->raw = raw;
+        state->raw_capacity = expected;
+    }
+
+    z_stream *zs = &state->inflater;
+    inflateReset(zs);
+    zs->next_out = state->raw;
+    zs->avail_out = (uInt)expected;
+
+    int ret = Z_OK;
+    for (int i = state->first_idat; i < state->chunk_count && ret == Z_OK; i++) {
+        if (chunks[i].type != CHUNK_IDAT) continue;
+        zs->next_in = (Bytef *)(buf + chunks[i].offset + 8);
+        zs->avail_in = chunks[i].length;
+        ret = inflate(zs, Z_NO_FLUSH);
+        if (ret == Z_BUF_ERROR && zs->avail_out == 0) ret = Z_STREAM_END;
+    }
+    if (ret != Z_OK && ret != Z_STREAM_END) return 0;
+
+    // keep only the rows that inflated completely
+    state->raw_size = zs->total_out;
+    while (state->row_count > 0) {
+        png_row_t *last = &state->rows[state->row_count - 1];
+        if (last->offset + 1 + last->length <= state->raw_size) break;
+        state->row_count--;
+    }
+    if (state->row_count == 0) return 0;
+
+    state->raw_state = 1;
+    return 1;
+}
+
+// mutate the filtered scanlines and rebuild the file with one fresh IDAT.
+// the edit is a byte range [dst, dst + len) replaced by src, and deflate is
+// fed the three pieces directly so the cached raw stream is never copied
+static size_t mutate_scanlines(afl_state_t *state, const uint8_t *buf, size_t buf_size,
+                               size_t max_size) {
+    if (!load_scanlines(state, buf)) return 0;
+
+    png_row_t *rows = state->rows;
+    png_row_t *row = &rows[rand_below(state, state->row_count)];
+    uint8_t byte;
+    const uint8_t *src = &byte;
+    size_t dst, len = 1;
+
+    switch (rand_below(state, 3)) {
+        case 0: {
+            // filter type: mostly valid (0-4), sometimes out of range
+            dst = row->offset;
+            byte = rand_below(state, 8) ? rand_below(state, 5) : rand_below(state, 256);
+            break;
+        }
+        case 1: {
+            // pixel byte
+            if (row->length == 0) return 0;
+            dst = row->offset + 1 + rand_below(state, row->length);
+            byte = rand_below(state, 256);
+            break;
+        }
+        default: {
+            // copy a neighbouring row of the same pass over this one, filter byte included
+            size_t i = row - rows;
+            png_row_t *other = &rows[i > 0 ? i - 1 : (i + 1) % state->row_count];
+            if (other->length != row->length) return 0;
+            dst = row->offset;
+            src = state->raw + other->offset;
+            len = 1 + (size_t)row->length;
+            break;
+        }
+    }
+
+    // same bytes back (equal neighbour row, same filter type): nothing to rebuild
+    if (!memcmp(state->raw + dst, src, len)) return 0;
+
+    png_chunk_t *chunks = state->chunks;
+    png_chunk_t *first = &chunks[state->first_idat];
+
+    // tail: every non-IDAT chunk after the first IDAT, plus trailing bytes
+    size_t tail_size = 0;
+    for (int i = state->first_idat; i < state->chunk_count; i++)
+        if (chunks[i].type != CHUNK_IDAT)
+            tail_size += 12 + (size_t)chunks[i].length;
+    png_chunk_t *last = &chunks[state->chunk_count - 1];
+    size_t indexed_end = last->offset + 12 + last->length;
+    tail_size += buf_size - indexed_end;
+
+    z_stream *zs = &state->deflater;
+    deflateReset(zs);
+    size_t bound = deflateBound(zs, state->raw_size);
+    size_t needed = first->offset + 12 + bound + tail_size;
+    if (needed > max_size || !ensure_output(state, needed)) return 0;
+
+    uint8_t *out = state->mutated_data;
+    memcpy(out, buf, first->offset);
+    uint8_t *idat = out + first->offset;
+
+    const uint8_t *pieces[3] = { state->raw, src, state->raw + dst + len };
+    size_t sizes[3] = { dst, len, state->raw_size - dst - len };
+    zs->next_out = idat + 8;
+    zs->avail_out = (uInt)bound;
+    for (int i = 0; i < 2; i++) {
+        zs->next_in = (Bytef *)pieces[i];
+        zs->avail_in = (uInt)sizes[i];
+        if (deflate(zs, Z_NO_FLUSH) == Z_STREAM_ERROR) return 0;
+    }
+    // anything short of Z_STREAM_END means the stream did not fit and would be truncated
+    zs->next_in = (Bytef *)pieces[2];
+    zs->avail_in = (uInt)sizes[2];
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END) return 0;
+    uint32_t idat_length = (uint32_t)zs->total_out;
+
+    write_be32(idat, idat_length);
+    write_be32(idat + 4, CHUNK_IDAT);
+    fix_crc(idat, 0, idat_length);
+
+    size_t out_size = first->offset + 12 + idat_length;
+    for (int i = state->first_idat; i < state->chunk_count; i++) {
+        if (chunks[i].type == CHUNK_IDAT) continue;
+        size_t chunk_size = 12 + (size_t)chunks[i].length;
+        memcpy(out + out_size, buf + chunks[i].offset, chunk_size);
+        out_size += chunk_size;
+    }
+    memcpy(out + out_size, buf + indexed_end, buf_size - indexed_end);
+    out_size += buf_size - indexed_end;
+
+    return out_size;
+}
+
+// chunk table for add_buf, without crcs: spliced chunks are copied whole, crc included
+static void index_donor(afl_state_t *state, const uint8_t *buf, size_t buf_size) {
+    state->donor_count = 0;
+    size_t offset = 8;
+    while (offset + 12 <= buf_size) {
+        uint32_t length = read_be32(buf + offset);
+        if (length > buf_size - offset - 12) break;
+
+        png_chunk_t *chunk = push_chunk(&state->donor_chunks, &state->donor_count,
+                                        &state->donor_capacity);
+        if (!chunk) break;
+        chunk->offset = offset;
+        chunk->length = length;
+        chunk->type = read_be32(buf + offset + 4);
+        chunk->crc_valid = 0;
+        offset += 12 + length;
+    }
+}
+
+static void add_ref(afl_state_t *state, const uint8_t *src, size_t size) {
+    state->refs[state->ref_count].src = src;
+    state->refs[state->ref_count].size = size;
+    state->ref_count++;
+}
+
+// every donor chunk of one type, in donor order
+static void add_donor_type(afl_state_t *state, const uint8_t *add_buf, uint32_t type) {
+    for (int i = 0; i < state->donor_count; i++) {
+        png_chunk_t *chunk = &state->donor_chunks[i];
+        if (chunk->type == type)
+            add_ref(state, add_buf + chunk->offset, 12 + (size_t)chunk->length);
+    }
+}
+
+// chunk-level crossover with add_buf. the child is a list of whole chunks from
+// both parents, sized first and then copied once into the output. buf's ihdr
+// stays first and its iend last, and moved chunks land where libpng expects
+// them: PLTE before tRNS/bKGD/hIST, ancillaries before the idat run, idat
+// chunks contiguous. returns 0 when add_buf has nothing to give
+static size_t mutate_splice(afl_state_t *state, const uint8_t *buf, size_t buf_size,
+                            const uint8_t *add_buf, size_t add_buf_size, size_t max_size) {
+    index_donor(state, add_buf, add_buf_size);
+    png_chunk_t *chunks = state->chunks;
+    png_chunk_t *donor = state->donor_chunks;
+    int count = state->chunk_count;
+    int donor_count = state->donor_count;
+
+    int movable = 0, donor_idat = 0;
+    for (int i = 0; i < donor_count; i++) {
+        if (donor[i].type != CHUNK_IHDR && donor[i].type != CHUNK_IEND) movable++;
+        if (donor[i].type == CHUNK_IDAT) donor_idat = 1;
+    }
+    if (movable == 0) return 0;
+
+    png_chunk_t *moved = NULL;
+    int pick = rand_below(state, movable);
+    for (int i = 0; i < donor_count && !moved; i++) {
+        if (donor[i].type == CHUNK_IHDR || donor[i].type == CHUNK_IEND) continue;
+        if (pick-- == 0) moved = &donor[i];
+    }
+    uint32_t type = moved->type;
+
+    // new chunks go in [lo, hi]: after ihdr, before iend
+    int lo = chunks[0].type == CHUNK_IHDR ? 1 : 0;
+    int hi = chunks[count - 1].type == CHUNK_IEND ? count - 1 : count;
+    int idat = state->first_idat >= 0 ? state->first_idat : hi;
+    int idat_end = idat;
+    while (idat_end < hi && chunks[idat_end].type == CHUNK_IDAT)
+        idat_end++;
+
+    // 0: insert the one donor chunk, 1: swap every chunk of its type for the
+    // donor's, 2: take the donor's ihdr and idat stream, keep our PLTE/tRNS/etc
+    int mode = rand_below(state, 3);
+    if (mode == 2 && (lo == 0 || state->first_idat < 0 ||
+                      donor[0].type != CHUNK_IHDR || !donor_idat))
+        mode = 1;
+    if (mode == 2)
+        type = CHUNK_IDAT;
+
+    int at = -1;
+    if (mode == 2) {
+        // placed alongside the ihdr / idat rewrites below
+    } else if (type == CHUNK_IDAT) {
+        at = mode == 0 ? idat_end : idat;
+    } else {
+        int own = -1, plte = -1;
+        for (int j = lo; j < hi; j++) {
+            if (chunks[j].type == type && own < 0) own = j;
+            if (chunks[j].type == CHUNK_PLTE && plte < 0) plte = j;
+        }
+        if (mode == 1 && own >= 0) {
+            at = own;
+        } else if (type == CHUNK_PLTE) {
+            at = lo;
+            while (at < idat && chunks[at].type != CHUNK_tRNS &&
+                   chunks[at].type != CHUNK_bKGD && chunks[at].type != CHUNK_hIST)
+                at++;
+        } else {
+            int first = lo;
+            if (plte >= 0 && (type == CHUNK_tRNS || type == CHUNK_bKGD ||
+                              type == CHUNK_hIST))
+                first = plte + 1;
+            if (first > idat) first = idat;
+            at = first + rand_below(state, idat - first + 1);
+        }
+    }
+
+    // at most: signature, every chunk of both parents, trailing bytes
+    int needed = count + donor_count + 2;
+    if (needed > state->ref_capacity) {
+        splice_ref_t *refs = (splice_ref_t *)realloc(state->refs, needed * sizeof(splice_ref_t));
+        if (!refs) return 0;
+        state->refs = refs;
+        state->ref_capacity = needed;
+    }
+    state->ref_count = 0;
+
+    add_ref(state, buf, 8);
+    for (int j = 0; j <= count; j++) {
+        if (j == at) {
+            if (mode == 0)
+                add_ref(state, add_buf + moved->offset, 12 + (size_t)moved->length);
+            else
+                add_donor_type(state, add_buf, type);
+        }
+        if (j == count) break;
+
+        if (mode == 2 && j == 0) {
+            add_ref(state, add_buf + donor[0].offset, 12 + (size_t)donor[0].length);
+            continue;
+        }
+        if (mode == 2 && j == idat)
+            add_donor_type(state, add_buf, CHUNK_IDAT);
+        if (mode != 0 && chunks[j].type == type)
+            continue;
+        add_ref(state, buf + chunks[j].offset, 12 + (size_t)chunks[j].length);
+    }
+    size_t indexed_end = chunks[count - 1].offset + 12 + chunks[count - 1].length;
+    add_ref(state, buf + indexed_end, buf_size - indexed_end);
+
+    size_t out_size = 0;
+    for (int i = 0; i < state->ref_count; i++)
+        out_size += state->refs[i].size;
+    if (out_size > max_size || !ensure_output(state, out_size))
+        return 0;
+
+    uint8_t *out = state->mutated_data;
+    for (int i = 0; i < state->ref_count; i++) {
+        memcpy(out, state->refs[i].src, state->refs[i].size);
+        out += state->refs[i].size;
+    }
+    return out_size;
+}
+
+// generative mode: well-formed pngs from a chunk grammar, for seedless
+// campaigns where random bytes never get past the signature and IHDR
+
+// bit depths allowed per color type (bit n set = depth 1 << n)
+static const uint8_t valid_depths[7] = {
+    0x1F,  // 0 gray: 1 2 4 8 16
+    0,
+    0x18,  // 2 rgb: 8 16
+    0x0F,  // 3 palette: 1 2 4 8
+    0x18,  // 4 gray + alpha: 8 16
+    0,
+    0x18,  // 6 rgba: 8 16
+};
+
+static const uint8_t color_types[5] = {0, 2, 3, 4, 6};
+
+static const char *text_keywords[] = {
+    "Title", "Author", "Description", "Copyright", "Creation Time",
+    "Software", "Disclaimer", "Warning", "Source", "Comment",
+};
+
+// cursor into the output while it is assembled; chunk is the open chunk's start
+typedef struct {
+    uint8_t *out;
+    size_t pos;
+    size_t end;
+    size_t chunk;
+} png_builder_t;
+
+static void open_chunk(png_builder_t *b, uint32_t type) {
+    b->chunk = b->pos;
+    write_be32(b->out + b->pos + 4, type);
+    b->pos += 8;
+}
+
+static void close_chunk(png_builder_t *b) {
+    uint32_t length = (uint32_t)(b->pos - b->chunk - 8);
+    write_be32(b->out + b->chunk, length);
+    write_be32(b->out + b->pos, chunk_crc(b->out + b->chunk + 4, length));
+    b->pos += 4;
+}
+
+static void put_u8(png_builder_t *b, uint8_t value) {
+    b->out[b->pos++] = value;
+}
+
+static void put_be16(png_builder_t *b, uint16_t value) {
+    b->out[b->pos++] = value >> 8;
+    b->out[b->pos++] = value & 0xFF;
+}
+
+static void put_be32(png_builder_t *b, uint32_t value) {
+    write_be32(b->out + b->pos, value);
+    b->pos += 4;
+}
+
+static void put_bytes(png_builder_t *b, const void *src, size_t size) {
+    memcpy(b->out + b->pos, src, size);
+    b->pos += size;
+}
+
+static void put_random(afl_state_t *state, png_builder_t *b, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        b->out[b->pos++] = next_rand(state) >> 24;
+}
+
+// latin-1 text without NULs, as tEXt/zTXt/iTXt require
+static void put_text(afl_state_t *state, png_builder_t *b, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        b->out[b->pos++] = 0x20 + rand_below(state, 0x5F);
+}
+
+// keyword plus its NUL separator
+static void put_keyword(afl_state_t *state, png_builder_t *b) {
+    const char *keyword = text_keywords[rand_below(state, sizeof(text_keywords) /
+                                                          sizeof(text_keywords[0]))];
+    put_bytes(b, keyword, strlen(keyword) + 1);
+}
+
+// one zlib stream straight into the open chunk
+static void put_deflated(afl_state_t *state, png_builder_t *b, const uint8_t *src, size_t size) {
+    z_stream *z = &state->deflater;
+    deflateReset(z);
+    z->next_in = (Bytef *)src;
+    z->avail_in = (uInt)size;
+    z->next_out = b->out + b->pos;
+    z->avail_out = (uInt)(b->end - b->pos);
+    deflate(z, Z_FINISH);
+    b->pos = z->next_out - b->out;
+}
+
+// small icc profile: header, a wtpt tag and a cprt tag of random text. passes
+// libpng's header and tag table checks, so the bytes reach the sRGB matching.
+// (libpng 1.6 reports "extra compressed data" for profiles that deflate to
+// almost nothing, hence the random text)
+#define ICC_MAX_SIZE (128 + 4 + 24 + 20 + 8 + 128)
+
+static size_t build_icc(afl_state_t *state, uint8_t *icc, int gray) {
+    static const uint8_t d50[12] = {0, 0, 0xF6, 0xD6, 0, 1, 0, 0, 0, 0, 0xD3, 0x2D};
+    uint32_t text_size = 16 + 4 * rand_below(state, 29);  // profile length % 4 == 0
+    size_t size = 128 + 4 + 24 + 20 + 8 + text_size;
+    memset(icc, 0, size);
+    write_be32(icc, (uint32_t)size);
+    write_be32(icc + 8, rand_below(state, 2) ? 0x02100000 : 0x04300000);
+    memcpy(icc + 12, "mntr", 4);
+    memcpy(icc + 16, gray ? "GRAY" : "RGB ", 4);
+    memcpy(icc + 20, "XYZ ", 4);
+    memcpy(icc + 36, "acsp", 4);
+    write_be32(icc + 64, rand_below(state, 4));
+    memcpy(icc + 68, d50, 12);
+    write_be32(icc + 128, 2);
+    memcpy(icc + 132, "wtpt", 4);
+    write_be32(icc + 136, 156);
+    write_be32(icc + 140, 20);
+    memcpy(icc + 144, "cprt", 4);
+    write_be32(icc + 148, 176);
+    write_be32(icc + 152, 8 + text_size);
+    memcpy(icc + 156, "XYZ ", 4);
+    memcpy(icc + 164, d50, 12);
+    memcpy(icc + 176, "text", 4);
+    for (uint32_t i = 0; i < text_size; i++)
+        icc[184 + i] = 0x20 + rand_below(state, 0x5F);
+    return size;
+}
+
+static void put_text_chunk(afl_state_t *state, png_builder_t *b) {
+    uint8_t text[256];
+    size_t text_size = rand_below(state, sizeof(text));
+    for (size_t i = 0; i < text_size; i++)
+        text[i] = 0x20 + rand_below(state, 0x5F);
+
+    switch (rand_below(state, 3)) {
+        case 0:
+            open_chunk(b, CHUNK_tEXt);
+            put_keyword(state, b);
+            put_bytes(b, text, text_size);
+            break;
+        case 1:
+            open_chunk(b, CHUNK_zTXt);
+            put_keyword(state, b);
+            put_u8(b, 0);
+            put_deflated(state, b, text, text_size);
+            break;
+        default: {
+            int compressed = rand_below(state, 2);
+            open_chunk(b, CHUNK_iTXt);
+            put_keyword(state, b);
+            put_u8(b, compressed);
+            put_u8(b, 0);
+            const char *language = rand_below(state, 2) ? "en" : "x-fuzz";
+            put_bytes(b, language, strlen(language) + 1);
+            put_text(state, b, rand_below(state, 16));
+            put_u8(b, 0);
+            if (compressed)
+                put_deflated(state, b, text, text_size);
+            else
+                put_bytes(b, text, text_size);
+            break;
+        }
+    }
+    close_chunk(b);
+}
+
+// synthesize a png into the output buffer; returns 0 if it would not fit max_size
+static size_t generate_png(afl_state_t *state, size_t max_size) {
+    if (!state->zlib_ready) return 0;
+
+    uint8_t ihdr[13] = {0};
+    uint8_t color = color_types[rand_below(state, 5)];
+    int depth;
+    do {
+        depth = 1 << rand_below(state, 5);
+    } while (!(valid_depths[color] & depth));
+    // mostly tiny images: deflate dominates the cost of a generated input
+    write_be32(ihdr, 1 + rand_below(state, 1 + rand_below(state, 64)));
+    write_be32(ihdr + 4, 1 + rand_below(state, 1 + rand_below(state, 64)));
+    ihdr[8] = depth;
+    ihdr[9] = color;
+    ihdr[12] = rand_below(state, 2);
+
+    // filtered scanlines with random filter types. layout_rows reuses the row
+    // table, so the cached scanlines of the current queue entry are dropped
+    size_t raw_size = layout_rows(state, ihdr);
+    state->raw_state = 0;
+    if (raw_size == 0) return 0;
+    if (raw_size > state->gen_capacity) {
+        uint8_t *raw = (uint8_t *)realloc(state->gen_raw, raw_size);
+        if (!raw) return 0;
+        state->gen_raw = raw;
+        state->gen_capacity = raw_size;
+    }
+    for (size_t i = 0; i < raw_size; i++)
+        state->gen_raw[i] = next_rand(state) >> 24;
+    for (size_t i = 0; i < state->row_count; i++)
+        state->gen_raw[state->rows[i].offset] = rand_below(state, 5);
+
+    // idat pieces are at least 256 bytes; everything else fits in 16 KB
+    uLong idat_bound = deflateBound(&state->deflater, raw_size);
+    size_t bound = 8 + 16384 + idat_bound + 12 * (idat_bound / 256 + 1);
+    if (bound > max_size || !ensure_output(state, bound))
+        return 0;
+
+    png_builder_t b = { state->mutated_data, 0, bound, 0 };
+    put_bytes(&b, PNG_SIGNATURE, 8);
+
+    open_chunk(&b, CHUNK_IHDR);
+    put_bytes(&b, ihdr, sizeof(ihdr));
+    close_chunk(&b);
+
+    if (rand_below(state, 2)) {
+        open_chunk(&b, CHUNK_gAMA);
+        put_be32(&b, rand_below(state, 2) ? 45455 : 1 + rand_below(state, 1000000));
+        close_chunk(&b);
+    }
+
+    if (rand_below(state, 3) == 0) {
+        uint8_t icc[ICC_MAX_SIZE];
+        size_t icc_size = build_icc(state, icc, !(color & 2));
+        open_chunk(&b, CHUNK_iCCP);
+        put_bytes(&b, "ICC profile", 12);
+        put_u8(&b, 0);
+        put_deflated(state, &b, icc, icc_size);
+        close_chunk(&b);
+    }
+
+    if (rand_below(state, 4) == 0) {
+        int sample_depth = rand_below(state, 2) ? 8 : 16;
+        open_chunk(&b, CHUNK_sPLT);
+        put_bytes(&b, "suggested", 10);
+        put_u8(&b, sample_depth);
+        put_random(state, &b, (1 + rand_below(state, 32)) * (sample_depth == 8 ? 6 : 10));
+        close_chunk(&b);
+    }
+
+    // required for palette images, an optional suggestion for truecolor
+    int palette_size = 0;
+    if (color == 3 || ((color & 2) && rand_below(state, 4) == 0)) {
+        int max_entries = color == 3 ? 1 << depth : 256;
+        palette_size = 1 + rand_below(state, max_entries);
+        open_chunk(&b, CHUNK_PLTE);
+        put_random(state, &b, palette_size * 3);
+        close_chunk(&b);
+    }
+
+    // alpha color types carry no tRNS
+    if (!(color & 4) && rand_below(state, 2)) {
+        uint16_t sample_mask = depth == 16 ? 0xFFFF : (1u << depth) - 1;
+        open_chunk(&b, CHUNK_tRNS);
+        if (color == 3) {
+            put_random(state, &b, 1 + rand_below(state, palette_size));
+        } else {
+            for (int i = 0; i < (color == 2 ? 3 : 1); i++)
+                put_be16(&b, next_rand(state) & sample_mask);
+        }
+        close_chunk(&b);
+    }
+
+    int texts = rand_below(state, 4);
+    for (int i = 0; i < texts; i++)
+        put_text_chunk(state, &b);
+
+    // one zlib stream cut into IDAT chunks of a random size. random pixels do
+    // not compress, so half the streams are stored blocks: cheaper, and they
+    // take inflate's stored path instead of the huffman decoder
+    z_stream *z = &state->deflater;
+    deflateReset(z);
+    if (rand_below(state, 2))
+        deflateParams(z, 0, Z_DEFAULT_STRATEGY);
+    z->next_in = state->gen_raw;
+    z->avail_in = (uInt)raw_size;
+    uint32_t piece = rand_below(state, 2) ? 256 + rand_below(state, 8192) : 0xFFFFFFFF;
+    int ret;
+    do {
+        open_chunk(&b, CHUNK_IDAT);
+        size_t room = b.end - b.pos - 4;
+        z->next_out = b.out + b.pos;
+        z->avail_out = (uInt)(room < piece ? room : piece);
+        ret = deflate(z, Z_FINISH);
+        b.pos = z->next_out - b.out;
+        close_chunk(&b);
+    } while (ret == Z_OK);
+    // back to level 1 for the scanline strategy; free on a freshly reset stream
+    deflateReset(z);
+    deflateParams(z, 1, Z_DEFAULT_STRATEGY);
+    if (ret != Z_STREAM_END)
+        return 0;
+
+    // tEXt and friends may also follow the image data
+    if (rand_below(state, 4) == 0)
+        put_text_chunk(state, &b);
+
+    open_chunk(&b, CHUNK_IEND);
+    close_chunk(&b);
+    return b.pos;
+}
+
 // custom mutator init
 void *afl_custom_init(void *afl, unsigned int seed) {
-    srand(seed);
+    (void)afl;
     afl_state_t *state = (afl_state_t *)calloc(1, sizeof(afl_state_t));
+    if (!state) return NULL;
+
+    // splitmix the seed so neighbouring seeds do not give correlated streams
+    uint64_t z = (uint64_t)seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    state->rng = (z ^ (z >> 31)) | 1;
+    state->last_strategy = -1;
+
+    // PNG_MUTATOR_STATS wins; otherwise next to afl's own fuzzer_stats
+    const char *stats = getenv("PNG_MUTATOR_STATS");
+    const char *out_dir = getenv("AFL_CUSTOM_INFO_OUT");
+    if (stats && *stats)
+        snprintf(state->stats_path, sizeof(state->stats_path), "%s", stats);
+    else if (out_dir && *out_dir)
+        snprintf(state->stats_path, sizeof(state->stats_path),
+                 "%s/png_mutator_stats", out_dir);
+
+    // level 1: the point is valid zlib framing around mutated scanlines, not ratio
+    if (inflateInit(&state->inflater) == Z_OK) {
+        if (deflateInit(&state->deflater, 1) == Z_OK)
+            state->zlib_ready = 1;
+        else
+            inflateEnd(&state->inflater);
+    }
     return state;
 }
 
+// afl is saving the last output (new path, crash or hang); name the strategy that made it
+const char *afl_custom_describe(void *data, size_t max_description_len) {
+    afl_state_t *state = (afl_state_t *)data;
+    static char description[64];
+
+    if (state->last_strategy < 0) return NULL;
+    state->saves[state->last_strategy]++;
+    snprintf(description, sizeof(description), DESCRIBE_PREFIX "%s",
+             strategy_names[state->last_strategy]);
+    if (max_description_len < sizeof(description))
+        description[max_description_len] = '\0';
+    return description;
+}
+
+// new queue entry; credit it to the strategy recorded in its filename by describe
+uint8_t afl_custom_queue_new_entry(void *data, const uint8_t *filename_new_queue,
+                                   const uint8_t *filename_orig_queue) {
+    (void)filename_orig_queue;
+    afl_state_t *state = (afl_state_t *)data;
+    const char *tag = filename_new_queue ?
+                      strstr((const char *)filename_new_queue, DESCRIBE_PREFIX) : NULL;
+    if (!tag) return 0;
+
+    tag += strlen(DESCRIBE_PREFIX);
+    for (int i = 0; i < STRAT_COUNT; i++) {
+        size_t len = strlen(strategy_names[i]);
+        if (!strncmp(tag, strategy_names[i], len) && (tag[len] == ',' || tag[len] == '\0')) {
+            state->new_paths[i]++;
+            break;
+        }
+    }
+    return 0;
+}
+
+// afl is about to fuzz a different queue entry
+uint8_t afl_custom_queue_get(void *data, const uint8_t *filename) {
+    (void)filename;
+    afl_state_t *state = (afl_state_t *)data;
+    state->index_valid = 0;
+    return 1;
+}
+
+// the picked arm keeps its failed attempt so ucb1 learns how rarely it applies;
+// the output, and any path or crash afl credits to it, belong to the arm that ran
+static int fall_back(afl_state_t *state, int strategy) {
+    state->last_strategy = strategy;
+    state->calls[strategy]++;
+    return strategy;
+}
+
 size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size,
                        uint8_t **out_buf, uint8_t *add_buf,
                        size_t add_buf_size, size_t max_size) {
 
     afl_state_t *state = (afl_state_t *)data;
 
-    // if not valid png, use default mutations
-    if (!is_png(buf, buf_size)) {
-        *out_buf = buf;
-        return buf_size;
+    // choose mutation strategy; anything that is not a png yet (an empty or
+    // seedless start) is replaced by a generated one
+    int strategy = is_png(buf, buf_size) ?
+                   pick_strategy(state, is_png(add_buf, add_buf_size)) : STRAT_GENERATE;
+    state->last_strategy = strategy;
+    state->calls[strategy]++;
+    if (++state->total_calls % STATS_INTERVAL == 0)
+        write_stats(state);
+
+    if (strategy == STRAT_GENERATE) {
+        size_t gen_size = generate_png(state, max_size);
+        if (gen_size) {
+            *out_buf = state->mutated_data;
+            state->mutated_size = gen_size;
+            return gen_size;
+        }
+        // too big for max_size: default mutations on whatever buf is
+        if (!is_png(buf, buf_size)) {
+            state->last_strategy = -1;
+            *out_buf = buf;
+            return buf_size;
+        }
+        strategy = fall_back(state, STRAT_BYTE_FLIP);
     }
 
     size_t new_size = buf_size + 4096;
     if (new_size > max_size) new_size = max_size;
 
-    if (state->mutated_data) free(state->mutated_data);
-    state->mutated_data = (uint8_t *)malloc(new_size);
-    if (!state->mutated_data) {
+    if (!ensure_output(state, new_size)) {
+        state->last_strategy = -1;
         *out_buf = buf;
         return buf_size;
     }
 
-    // copy original data
-    memcpy(state->mutated_data, buf, buf_size);
+    uint8_t *out = state->mutated_data;
     size_t out_size = buf_size;
 
-    // choose mutation strategy
-    int strategy = rand() % 10;
-
     if (buf_size < 20) {
-        *out_buf = state->mutated_data;
+        state->last_strategy = -1;
+        memcpy(out, buf, buf_size);
+        *out_buf = out;
         return out_size;
     }
 
-    switch (strategy) {
-        case 0:
-        case 1: {
-            // corrupt crc of random chukn
-            size_t offset = 8;
-            int chunk_count = 0;
-
-            // count chunks
-            while (offset + 12 <= buf_size) {
-                uint32_t length = read_be32(state->mutated_data + offset);
-                if (offset + 12 + length > buf_size) break;
-                chunk_count++;
-                offset += 12 + length;
-            }
+    index_chunks(state, buf, buf_size);
+    png_chunk_t *chunks = state->chunks;
+    int chunk_count = state->chunk_count;
 
-            if (chunk_count > 0) {
-                int target_chunk = rand() % chunk_count;
-                offset = 8;
+    if (chunk_count == 0 && strategy != STRAT_BYTE_FLIP)
+        strategy = fall_back(state, STRAT_BYTE_FLIP);
 
-                // find target chunk
-                for (int i = 0; i < target_chunk; i++) {
-                    uint32_t length = read_be32(state->mutated_data + offset);
-                    offset += 12 + length;
-                }
+    if (strategy == STRAT_SCANLINE) {
+        size_t scan_size = mutate_scanlines(state, buf, buf_size, max_size);
+        if (scan_size) {
+            *out_buf = state->mutated_data;
+            state->mutated_size = scan_size;
+            return scan_size;
+        }
+        // not inflatable, a no-op edit, or too big to rebuild: plain idat byte instead
+        strategy = fall_back(state, STRAT_IDAT_BYTE);
+        out = state->mutated_data;
+    }
 
-                uint32_t length = read_be32(state->mutated_data + offset);
-                if (offset + 12 + length <= buf_size) {
-                    // corrupt crc
-                    uint32_t crc = read_be32(state->mutated_data + offset + 8 + length);
-                    crc ^= (1 << (rand() % 32));
-                    write_be32(state->mutated_data + offset + 8 + length, crc);
-                }
-            }
+    if (strategy == STRAT_SPLICE) {
+        size_t splice_size = mutate_splice(state, buf, buf_size, add_buf, add_buf_size,
+                                           max_size);
+        if (splice_size) {
+            *out_buf = state->mutated_data;
+            state->mutated_size = splice_size;
+            return splice_size;
+        }
+        // donor had no movable chunks, or the child would not fit
+        strategy = fall_back(state, STRAT_DUPLICATE);
+        out = state->mutated_data;
+    }
+
+    switch (strategy) {
+        case STRAT_CRC_CORRUPT: {
+            // corrupt crc of random chunk
+            memcpy(out, buf, buf_size);
+            png_chunk_t *chunk = &chunks[rand_below(state, chunk_count)];
+            size_t crc_offset = chunk->offset + 8 + chunk->length;
+            uint32_t crc = read_be32(out + crc_offset);
+            crc ^= (1u << rand_below(state, 32));
+            write_be32(out + crc_offset, crc);
             break;
         }
 
-        case 2:
-        case 3: {
+        case STRAT_LENGTH: {
             // modify chunk length field
-            size_t offset = 8 + (rand() % (buf_size - 8));
-            if (offset + 4 <= buf_size) {
-                uint32_t length = read_be32(state->mutated_data + offset);
-
-                // try diff length mutations
-                int mutation = rand() % 4;
-                switch (mutation) {
-                    case 0: length += rand() % 256; break;
-                    case 1: length -= rand() % 256; break;
-                    case 2: length = 0xFFFFFFFF; break;
-                    case 3: length = 0; break;
-                }
+            png_chunk_t *chunk = &chunks[rand_below(state, chunk_count)];
+            uint32_t length = chunk->length;
+
+            // try diff length mutations
+            int mutation = rand_below(state, 4);
+            switch (mutation) {
+                case 0: length += rand_below(state, 256); break;
+                case 1: length -= rand_below(state, 256); break;
+                case 2: length = 0xFFFFFFFF; break;
+                case 3: length = 0; break;
+            }
+
+            size_t data_start = chunk->offset + 8;
+            size_t chunk_end = data_start + chunk->length + 4;
+            size_t resized = out_size - chunk->length + length;
 
-                write_be32(state->mutated_data + offset, length);
+            // bogus lengths (past 2^31 or the size limit) stay raw, libpng rejects those early
+            if (length > 0x7FFFFFFF || length > chunk->length + (new_size - out_size)) {
+                memcpy(out, buf, buf_size);
+                write_be32(out + chunk->offset, length);
+                break;
             }
+
+            // otherwise really resize the chunk so the crc can be made to match
+            uint32_t kept = length < chunk->length ? length : chunk->length;
+            memcpy(out, buf, data_start + kept);
+            memset(out + data_start + kept, rand_below(state, 256), length - kept);
+            write_be32(out + chunk->offset, length);
+            memcpy(out + data_start + length + 4, buf + chunk_end, buf_size - chunk_end);
+            if (chunk->crc_valid)
+                fix_crc(out, chunk->offset, length);
+            else
+                memcpy(out + data_start + length, buf + chunk_end - 4, 4);
+            out_size = resized;
             break;
         }
 
-        case 4: {
+        case STRAT_IHDR_FLIP: {
             // flip bits in ihdr chunk
-            size_t offset = 8;
-            if (offset + 12 <= buf_size) {
-                uint32_t length = read_be32(state->mutated_data + offset);
-                uint32_t type = read_be32(state->mutated_data + offset + 4);
-
-                if (type == CHUNK_IHDR && offset + 12 + length <= buf_size) {
-                    // flip random bits in ihdr data
-                    int byte_offset = rand() % length;
-                    int bit_offset = rand() % 8;
-                    state->mutated_data[offset + 8 + byte_offset] ^= (1 << bit_offset);
-                }
+            memcpy(out, buf, buf_size);
+            if (chunks[0].type == CHUNK_IHDR && chunks[0].length > 0) {
+                size_t pos = chunks[0].offset + 8 + rand_below(state, chunks[0].length);
+                uint8_t old_byte = out[pos];
+                out[pos] ^= (1 << rand_below(state, 8));
+                if (chunks[0].crc_valid)
+                    patch_crc(out, &chunks[0], pos, old_byte);
             }
             break;
         }
 
-        case 5: {
-            // duplicate chunk
-            size_t offset = 8;
-            int chunk_count = 0;
-
-            while (offset + 12 <= buf_size) {
-                uint32_t length = read_be32(state->mutated_data + offset);
-                if (offset + 12 + length > buf_size) break;
-                chunk_count++;
-                offset += 12 + length;
-            }
-
-            if (chunk_count > 0) {
-                int target_chunk = rand() % chunk_count;
-                offset = 8;
-
-                for (int i = 0; i < target_chunk; i++) {
-                    uint32_t length = read_be32(state->mutated_data + offset);
-                    offset += 12 + length;
-                }
+        case STRAT_DUPLICATE: {
+            // duplicate chunk, assembled straight into the output
+            png_chunk_t *chunk = &chunks[rand_below(state, chunk_count)];
+            size_t chunk_size = 12 + (size_t)chunk->length;
+            size_t chunk_end = chunk->offset + chunk_size;
 
-                uint32_t length = read_be32(state->mutated_data + offset);
-                size_t chunk_size = 12 + length;
-
-                if (out_size + chunk_size <= new_size) {
-                    // insert duplicate after current chunk
-                    memmove(state->mutated_data + offset + chunk_size * 2,
-                           state->mutated_data + offset + chunk_size,
-                           out_size - offset - chunk_size);
-                    memcpy(state->mutated_data + offset + chunk_size,
-                          state->mutated_data + offset,
-                          chunk_size);
-                    out_size += chunk_size;
-                }
+            if (out_size + chunk_size <= new_size) {
+                memcpy(out, buf, chunk_end);
+                memcpy(out + chunk_end, buf + chunk->offset, chunk_size);
+                memcpy(out + chunk_end + chunk_size, buf + chunk_end, buf_size - chunk_end);
+                out_size += chunk_size;
+            } else {
+                memcpy(out, buf, buf_size);
             }
             break;
         }
 
-        case 6: {
+        case STRAT_TYPE: {
             // modify chunk type
-            size_t offset = 8 + (rand() % (buf_size - 20));
-            if (offset + 8 <= buf_size) {
-                state->mutated_data[offset + 4 + (rand() % 4)] = rand() % 256;
-            }
+            memcpy(out, buf, buf_size);
+            png_chunk_t *chunk = &chunks[rand_below(state, chunk_count)];
+            size_t pos = chunk->offset + 4 + rand_below(state, 4);
+            uint8_t old_byte = out[pos];
+            out[pos] = rand_below(state, 256);
+            if (chunk->crc_valid)
+                patch_crc(out, chunk, pos, old_byte);
             break;
         }
 
-        case 7: {
+        case STRAT_IDAT_BYTE: {
             // corrupt idat
-            size_t offset = 8;
-
-            while (offset + 12 <= buf_size) {
-                uint32_t length = read_be32(state->mutated_data + offset);
-                uint32_t type = read_be32(state->mutated_data + offset + 4);
-
-                if (type == CHUNK_IDAT && offset + 12 + length <= buf_size) {
-                    // flip random byte in compressed data
-                    if (length > 0) {
-                        int byte_offset = rand() % length;
-                        state->mutated_data[offset + 8 + byte_offset] = rand() % 256;
-                    }
-                    break;
+            memcpy(out, buf, buf_size);
+            if (state->first_idat >= 0) {
+                png_chunk_t *chunk = &chunks[state->first_idat];
+                // flip random byte in compressed data
+                if (chunk->length > 0) {
+                    size_t pos = chunk->offset + 8 + rand_below(state, chunk->length);
+                    uint8_t old_byte = out[pos];
+                    out[pos] = rand_below(state, 256);
+                    if (chunk->crc_valid)
+                        patch_crc(out, chunk, pos, old_byte);
                 }
-
-                if (offset + 12 + length > buf_size) break;
-                offset += 12 + length;
             }
             break;
         }
 
-        case 8: {
+        case STRAT_REMOVE: {
             // remove chunk except ihdr and iend
-            size_t offset = 8;
-
-            while (offset + 12 <= buf_size) {
-                uint32_t length = read_be32(state->mutated_data + offset);
-                uint32_t type = read_be32(state->mutated_data + offset + 4);
-
-                if (type != CHUNK_IHDR && type != CHUNK_IEND &&
-                    offset + 12 + length <= buf_size) {
-                    size_t chunk_size = 12 + length;
-                    memmove(state->mutated_data + offset,
-                           state->mutated_data + offset + chunk_size,
-                           out_size - offset - chunk_size);
-                    out_size -= chunk_size;
-                    break;
-                }
-
-                if (offset + 12 + length > buf_size) break;
-                offset += 12 + length;
+            if (state->first_removable < 0) {
+                memcpy(out, buf, buf_size);
+                break;
             }
+
+            png_chunk_t *chunk = &chunks[state->first_removable];
+            size_t chunk_size = 12 + (size_t)chunk->length;
+            size_t chunk_end = chunk->offset + chunk_size;
+
+            memcpy(out, buf, chunk->offset);
+            memcpy(out + chunk->offset, buf + chunk_end, buf_size - chunk_end);
+            out_size -= chunk_size;
             break;
         }
 
         default: {
             // random byte flip
-            if (buf_size > 8) {
-                size_t pos = 8 + (rand() % (buf_size - 8));
-                state->mutated_data[pos] = rand() % 256;
+            memcpy(out, buf, buf_size);
+            size_t pos = 8 + rand_below(state, buf_size - 8);
+            uint8_t old_byte = out[pos];
+            out[pos] = rand_below(state, 256);
+
+            // repair the chunk it landed in, unless it hit a length or crc field
+            int lo = 0, hi = chunk_count - 1;
+            while (lo < hi) {
+                int mid = (lo + hi + 1) / 2;
+                if (chunks[mid].offset <= pos) lo = mid;
+                else hi = mid - 1;
             }
+            png_chunk_t *chunk = chunk_count > 0 ? &chunks[lo] : NULL;
+            if (chunk && chunk->crc_valid && pos >= chunk->offset + 4 &&
+                pos < chunk->offset + 8 + chunk->length)
+                patch_crc(out, chunk, pos, old_byte);
             break;
         }
     }
 
-    *out_buf = state->mutated_data;
+    *out_buf = out;
     state->mutated_size = out_size;
     return out_size;
 }
@@ -268,7 +1307,18 @@ size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size,
 void afl_custom_deinit(void *data) {
     afl_state_t *state = (afl_state_t *)data;
     if (state) {
+        write_stats(state);
         if (state->mutated_data) free(state->mutated_data);
+        if (state->chunks) free(state->chunks);
+        if (state->donor_chunks) free(state->donor_chunks);
+        if (state->refs) free(state->refs);
+        if (state->gen_raw) free(state->gen_raw);
+        if (state->raw) free(state->raw);
+        if (state->rows) free(state->rows);
+        if (state->zlib_ready) {
+            inflateEnd(&state->inflater);
+            deflateEnd(&state->deflater);
+        }
         free(state);
     }
 }
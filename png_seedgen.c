@@ -0,0 +1,60 @@
+// writes pngs synthesized by png_mutator.c's generative mode, for campaigns that
+// would otherwise start from build/empty-seeds. an input that is not a png makes
+// afl_custom_fuzz generate one, so this needs nothing beyond the mutator api
+// usage: png-seedgen <out_dir> [count] [seed]
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+void *afl_custom_init(void *afl, unsigned int seed);
+size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size,
+                       uint8_t **out_buf, uint8_t *add_buf,
+                       size_t add_buf_size, size_t max_size);
+void afl_custom_deinit(void *data);
+
+#define MAX_SIZE (1024 * 1024)
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <out_dir> [count] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    long count = (argc >= 3) ? atol(argv[2]) : 64;
+    unsigned int seed = (argc >= 4) ? (unsigned int)atol(argv[3]) : 1;
+    if (mkdir(argv[1], 0755) != 0 && errno != EEXIST) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    void *state = afl_custom_init(NULL, seed);
+    if (!state) {
+        fprintf(stderr, "afl_custom_init failed\n");
+        return 1;
+    }
+
+    long written = 0;
+    for (long i = 0; i < count; i++) {
+        uint8_t *out = NULL;
+        size_t size = afl_custom_fuzz(state, NULL, 0, &out, NULL, 0, MAX_SIZE);
+        if (size == 0) continue;
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/gen_%06ld.png", argv[1], i);
+        FILE *fp = fopen(path, "wb");
+        if (!fp) {
+            perror(path);
+            break;
+        }
+        if (fwrite(out, 1, size, fp) == size)
+            written++;
+        fclose(fp);
+    }
+
+    afl_custom_deinit(state);
+    printf("wrote %ld pngs to %s\n", written, argv[1]);
+    return 0;
+}
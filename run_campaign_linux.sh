@@ -0,0 +1,355 @@
+#!/bin/bash
+
+# Linux - run one AFL++ campaign as a single -M/-S group, one instance per core.
+# The main instance runs the plain harness with its CmpLog companion; secondaries
+# mix in the custom mutator, the ASAN+UBSAN harness, the laf-intel build and more
+# CmpLog instances, and every instance syncs through one -o dir.
+#
+# usage: ./run_campaign_linux.sh [options]
+#   -n N        instances in the group (default: all cores)
+#   -t SECONDS  wall-clock budget (default: 3600; per step with -s)
+#   -i DIR      seed directory (default: build/seeds)
+#   -o DIR      output directory (default: build/output-campaign)
+#   -c CPU      first core to pin to (default: 0)
+#   -P          plain instances only, no ASAN / custom mutator / CmpLog / laf-intel
+#   -T TARGET   b (libpng 1.6.43, default) or vuln (1.6.15 from build_vulnerable.sh)
+#   -s "1 2 4"  scaling run: one campaign per instance count, then a report
+#   -f          replace the output directory even if it is not empty
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${SCRIPT_DIR}/build"
+AFL_FUZZ="${BUILD_DIR}/AFLplusplus/afl-fuzz"
+
+INSTANCES=$(nproc)
+DURATION=3600
+SEEDS_DIR="${BUILD_DIR}/seeds"
+OUTPUT_DIR="${BUILD_DIR}/output-campaign"
+FIRST_CPU=0
+PLAIN=0
+SCALING=""
+TARGET=b
+FORCE=0
+
+while getopts "n:t:i:o:c:Ps:T:f" opt; do
+    case $opt in
+        n) INSTANCES=$OPTARG ;;
+        t) DURATION=$OPTARG ;;
+        i) SEEDS_DIR=$OPTARG ;;
+        o) OUTPUT_DIR=$OPTARG ;;
+        c) FIRST_CPU=$OPTARG ;;
+        P) PLAIN=1 ;;
+        s) SCALING=$OPTARG ;;
+        T) TARGET=$OPTARG ;;
+        f) FORCE=1 ;;
+        *) sed -n '8,17p' "$0"; exit 1 ;;
+    esac
+done
+
+# plain, ASAN and persistent ASAN binaries of each target; -cmplog and -laf
+# variants of the plain one come from build_linux.sh / build_vulnerable.sh
+case "${TARGET}" in
+    b) PLAIN_BIN=harness-b; ASAN_BIN=harness-c-linux; ASAN_PERSISTENT_BIN=harness-c-persistent ;;
+    vuln) PLAIN_BIN=harness-vuln-b; ASAN_BIN=harness-vuln-c; ASAN_PERSISTENT_BIN="" ;;
+    *) echo "ERROR: unknown target ${TARGET} (b or vuln)"; exit 1 ;;
+esac
+
+if [ ! -x "${AFL_FUZZ}" ]; then
+    echo "ERROR: AFL++ not found. Please run build_linux.sh first."
+    exit 1
+fi
+
+# start_group wipes its output directory, and -o may point anywhere
+if [ -d "${OUTPUT_DIR}" ] && [ -n "$(ls -A "${OUTPUT_DIR}")" ] && [ "$FORCE" -eq 0 ]; then
+    echo "ERROR: ${OUTPUT_DIR} is not empty; remove it or pass -f to replace it"
+    exit 1
+fi
+
+export AFL_SKIP_CPUFREQ=1
+export AFL_I_DONT_CARE_ABOUT_MISSING_CRASHES=1
+export AFL_NO_UI=1
+# persistent instances get no output path; without this they would skip the
+# re-encode the @@ instances run, and the group would sync queues built on
+# different coverage. harness.env records it, so triage replays the same way
+export HARNESS_SINK="${HARNESS_SINK:-mem}"
+
+# secondaries rotate power schedules so they do not all chase the same entries
+SCHEDULES=(fast explore coe rare)
+
+# seconds between liveness checks, and how long SIGINT gets before SIGKILL
+POLL_INTERVAL=5
+STOP_GRACE=15
+
+PIDS=()
+MONITOR_PID=""
+# what start_group actually launched, e.g. "main (plain, -c cmplog), 1 mutator, 1 asan"
+GROUP_MIX=""
+
+# main is plain (with CmpLog when built); secondaries cycle mutator, asan, laf, cmplog
+instance_kind() {
+    local i=$1
+    if [ "$i" -eq 0 ] || [ "$PLAIN" -eq 1 ]; then
+        echo plain
+        return
+    fi
+    case $((i % 4)) in
+        1) if [ -f "${BUILD_DIR}/png_mutator.so" ]; then echo mutator; else echo plain; fi ;;
+        2) if [ -x "${BUILD_DIR}/${ASAN_BIN}" ]; then echo asan; else echo plain; fi ;;
+        3) if [ -x "${BUILD_DIR}/${PLAIN_BIN}-laf" ]; then echo laf; else echo plain; fi ;;
+        *) if [ -x "${BUILD_DIR}/${PLAIN_BIN}-cmplog" ]; then echo cmplog; else echo plain; fi ;;
+    esac
+}
+
+# persistent build of a binary when it exists, else the @@ one
+pick_binary() {
+    local bin=$1
+    local persistent=$2
+    local name=$3
+    if [ -n "$persistent" ] && [ -x "${BUILD_DIR}/${persistent}" ]; then
+        HARNESS_ARGS=("${BUILD_DIR}/${persistent}")
+    else
+        HARNESS_ARGS=("${BUILD_DIR}/${bin}" @@ "/tmp/out-${name}.png")
+    fi
+}
+
+# target command line for one instance, plus -c for main and cmplog instances.
+# the CmpLog binary has to run in the same mode (persistent or @@) as the target
+harness_cmd() {
+    local kind=$1
+    local name=$2
+    CMPLOG_ARGS=()
+    case "$kind" in
+        asan) pick_binary "${ASAN_BIN}" "${ASAN_PERSISTENT_BIN}" "$name" ;;
+        laf) pick_binary "${PLAIN_BIN}-laf" "${PLAIN_BIN}-laf-persistent" "$name" ;;
+        *) pick_binary "${PLAIN_BIN}" "${PLAIN_BIN}-persistent" "$name" ;;
+    esac
+
+    if [ "$kind" = cmplog ] || { [ "$name" = main ] && [ "$PLAIN" -eq 0 ]; }; then
+        local cmplog="${BUILD_DIR}/${PLAIN_BIN}-cmplog"
+        [ "${#HARNESS_ARGS[@]}" -eq 1 ] && cmplog="${cmplog}-persistent"
+        if [ -x "$cmplog" ]; then
+            CMPLOG_ARGS=(-c "$cmplog")
+        fi
+    fi
+}
+
+any_alive() {
+    local pid
+    for pid in "${PIDS[@]}"; do
+        if kill -0 "$pid" 2>/dev/null; then
+            return 0
+        fi
+    done
+    return 1
+}
+
+# SIGINT lets afl-fuzz write its final stats; SIGKILL whatever is left after the grace period
+stop_group() {
+    local pid
+    for pid in "${PIDS[@]}"; do
+        kill -INT "$pid" 2>/dev/null || true
+    done
+    local grace_end=$(( $(date +%s) + STOP_GRACE ))
+    while any_alive && [ "$(date +%s)" -lt "$grace_end" ]; do
+        sleep 1
+    done
+    for pid in "${PIDS[@]}"; do
+        kill -KILL "$pid" 2>/dev/null || true
+        wait "$pid" 2>/dev/null || true
+    done
+    PIDS=()
+    # one last sample records the stopped instances before the monitor goes
+    if [ -n "${MONITOR_PID}" ]; then
+        sleep 1
+        kill -TERM "${MONITOR_PID}" 2>/dev/null || true
+        wait "${MONITOR_PID}" 2>/dev/null || true
+        MONITOR_PID=""
+    fi
+}
+
+trap 'echo ""; echo "Interrupted, stopping all instances..."; stop_group; exit 130' INT TERM
+
+# start COUNT instances syncing through OUT_DIR, each told to stop after BUDGET seconds
+start_group() {
+    local count=$1
+    local out_dir=$2
+    local budget=$3
+
+    if [ $((FIRST_CPU + count)) -gt "$(nproc)" ]; then
+        echo "ERROR: ${count} instances from cpu ${FIRST_CPU} need more than $(nproc) cores"
+        exit 1
+    fi
+
+    rm -rf "${out_dir}"
+    mkdir -p "${out_dir}"
+    # every instance inherits these; triage_crashes.sh replays the crashes with them
+    env | grep '^HARNESS_' > "${out_dir}/harness.env" || true
+    PIDS=()
+    GROUP_MIX=""
+    local -A kind_count=()
+
+    local i
+    for ((i = 0; i < count; i++)); do
+        local kind
+        kind=$(instance_kind "$i")
+        local cpu=$((FIRST_CPU + i))
+        local name role extra env_args
+        if [ "$i" -eq 0 ]; then
+            name=main
+            role=(-M main)
+        else
+            name="sec${i}-${kind}"
+            role=(-S "$name" -p "${SCHEDULES[i % ${#SCHEDULES[@]}]}")
+        fi
+        extra=()
+        env_args=()
+        if [ "$kind" = asan ]; then
+            extra=(-m none)
+        elif [ "$kind" = mutator ]; then
+            env_args=(AFL_CUSTOM_MUTATOR_LIBRARY="${BUILD_DIR}/png_mutator.so")
+        fi
+        harness_cmd "$kind" "$name"
+
+        env "${env_args[@]}" "${AFL_FUZZ}" \
+            -i "${SEEDS_DIR}" \
+            -o "${out_dir}" \
+            "${role[@]}" \
+            -b "$cpu" \
+            -V "$budget" \
+            "${extra[@]}" \
+            "${CMPLOG_ARGS[@]}" \
+            -- "${HARNESS_ARGS[@]}" \
+            > "${out_dir}/${name}.log" 2>&1 &
+        PIDS+=($!)
+        echo "  ${name} (${kind}${CMPLOG_ARGS[1]:+, -c $(basename "${CMPLOG_ARGS[1]}")}) on cpu ${cpu}, PID $!"
+
+        if [ "$i" -eq 0 ]; then
+            GROUP_MIX="main (${kind}${CMPLOG_ARGS[1]:+, -c cmplog})"
+        else
+            kind_count[$kind]=$(( ${kind_count[$kind]:-0} + 1 ))
+        fi
+    done
+
+    local k
+    for k in mutator asan laf cmplog plain; do
+        [ -n "${kind_count[$k]}" ] && GROUP_MIX="${GROUP_MIX}, ${kind_count[$k]} ${k}"
+    done
+    return 0
+}
+
+# afl-fuzz -V normally ends each instance; anything still running at the
+# wall-clock deadline (e.g. one that spent minutes in calibration) is stopped
+wait_for_group() {
+    local deadline=$1
+    while any_alive && [ "$(date +%s)" -lt "$deadline" ]; do
+        sleep "${POLL_INTERVAL}"
+    done
+    if any_alive; then
+        echo "Deadline reached, stopping remaining instances..."
+    fi
+    stop_group
+}
+
+stat_value() {
+    awk -F' *: *' -v key="$2" '$1 == key { print $2 }' "$1" 2>/dev/null
+}
+
+# one line per group: instances, total execs, edges and corpus as main sees them, crashes
+summarize_group() {
+    local out_dir=$1
+    local count=$2
+    local execs=0 crashes=0 stats value
+    for stats in "${out_dir}"/*/fuzzer_stats; do
+        [ -f "$stats" ] || continue
+        value=$(stat_value "$stats" execs_done)
+        execs=$((execs + ${value:-0}))
+        value=$(stat_value "$stats" saved_crashes)
+        crashes=$((crashes + ${value:-0}))
+    done
+    local edges corpus
+    edges=$(stat_value "${out_dir}/main/fuzzer_stats" edges_found)
+    corpus=$(stat_value "${out_dir}/main/fuzzer_stats" corpus_count)
+    echo "${count} ${execs} ${edges:-0} ${corpus:-0} ${crashes}"
+}
+
+run_campaign() {
+    local count=$1
+    local out_dir=$2
+
+    if [ "$PLAIN" -eq 0 ] && [ "$count" -gt 2 ]; then
+        # ASAN secondaries need the larger mmap randomization window
+        sudo sysctl -w vm.mmap_rnd_bits=28 >/dev/null 2>&1 || true
+    fi
+
+    echo ""
+    echo "Starting ${count} instance(s) for ${DURATION}s -> ${out_dir}"
+    local start
+    start=$(date +%s)
+    start_group "$count" "$out_dir" "$DURATION"
+
+    # live telemetry next to the instances; only its alerts reach the console
+    "${SCRIPT_DIR}/campaign_monitor.sh" -o "${out_dir}/telemetry" "${out_dir}" \
+        > >(grep --line-buffered '^ALERT' || true) &
+    MONITOR_PID=$!
+    wait_for_group $((start + DURATION))
+    ELAPSED=$(( $(date +%s) - start ))
+    echo "Group finished after ${ELAPSED}s"
+}
+
+if [ -z "${SCALING}" ]; then
+    echo "===== AFL++ Campaign: ${INSTANCES} instance(s) ====="
+    run_campaign "${INSTANCES}" "${OUTPUT_DIR}"
+
+    read -r count execs edges corpus crashes <<< "$(summarize_group "${OUTPUT_DIR}" "${INSTANCES}")"
+    echo ""
+    echo "===== Results ====="
+    echo "Instances:       ${count}"
+    echo "Mix:             ${GROUP_MIX}"
+    echo "Total execs:     ${execs}"
+    echo "Aggregate exec/s: $((execs / (ELAPSED > 0 ? ELAPSED : 1)))"
+    echo "Edges (main):    ${edges}"
+    echo "Corpus (main):   ${corpus}"
+    echo "Crashes (all):   ${crashes}"
+    echo ""
+    echo "Per-instance status: ${BUILD_DIR}/AFLplusplus/afl-whatsup ${OUTPUT_DIR}"
+    echo "Telemetry:           ${OUTPUT_DIR}/telemetry/telemetry.csv"
+    exit 0
+fi
+
+# scaling run: same budget per step, one fresh output directory per instance count
+echo "===== AFL++ Scaling Run: ${SCALING} instance(s), ${DURATION}s each ====="
+mkdir -p "${OUTPUT_DIR}"
+REPORT="${OUTPUT_DIR}/scaling_report.md"
+ROWS=()
+MIXES=()
+for n in ${SCALING}; do
+    run_campaign "$n" "${OUTPUT_DIR}/scale-${n}"
+    ROWS+=("$(summarize_group "${OUTPUT_DIR}/scale-${n}" "$n") ${ELAPSED}")
+    MIXES+=("- ${n}: ${GROUP_MIX}")
+done
+
+{
+    echo "# Scaling report"
+    echo ""
+    echo "Budget per step: ${DURATION}s."
+    echo "Efficiency is exec/s per instance relative to the first row; edges and corpus are the main instance's."
+    echo ""
+    echo "Instances launched per step:"
+    echo ""
+    printf '%s\n' "${MIXES[@]}"
+    echo ""
+    echo "| instances | exec/s (total) | exec/s per instance | efficiency | edges | corpus | crashes |"
+    echo "|----------:|---------------:|--------------------:|-----------:|------:|-------:|--------:|"
+    printf '%s\n' "${ROWS[@]}" | awk '{
+        rate = $2 / ($6 > 0 ? $6 : 1)
+        per = rate / $1
+        if (NR == 1) base = per
+        printf "| %d | %.0f | %.0f | %.2f | %d | %d | %d |\n", $1, rate, per, (base > 0 ? per / base : 0), $3, $4, $5
+    }'
+} > "${REPORT}"
+
+echo ""
+cat "${REPORT}"
+echo ""
+echo "Report written to ${REPORT}"
@@ -33,19 +33,27 @@ run_with_timeout() {
     # Start fuzzing in background
     "${cmd[@]}" &
     local fuzz_pid=$!
+    local deadline=$(( $(date +%s) + time_limit ))
 
     echo "Fuzzing PID: $fuzz_pid"
     echo "Will run for $time_limit seconds..."
 
-    # Wait for time limit
-    sleep "$time_limit"
+    # Poll until the deadline, returning early if the fuzzer exits on its own
+    while kill -0 "$fuzz_pid" 2>/dev/null && [ "$(date +%s)" -lt "$deadline" ]; do
+        sleep 5
+    done
 
-    # Kill the fuzzer
-    echo ""
-    echo "Time limit reached, stopping fuzzer..."
-    kill -INT "$fuzz_pid" 2>/dev/null || true
-    sleep 2
-    kill -KILL "$fuzz_pid" 2>/dev/null || true
+    # SIGINT lets afl-fuzz write its final stats; SIGKILL only if it ignores that
+    if kill -0 "$fuzz_pid" 2>/dev/null; then
+        echo ""
+        echo "Time limit reached, stopping fuzzer..."
+        kill -INT "$fuzz_pid" 2>/dev/null || true
+        local grace_end=$(( $(date +%s) + 15 ))
+        while kill -0 "$fuzz_pid" 2>/dev/null && [ "$(date +%s)" -lt "$grace_end" ]; do
+            sleep 1
+        done
+        kill -KILL "$fuzz_pid" 2>/dev/null || true
+    fi
 
     wait "$fuzz_pid" 2>/dev/null || true
 }
@@ -0,0 +1,113 @@
+#!/bin/bash
+
+# Replay every crash and hang from all build/output-* campaigns against the
+# ASAN+UBSAN harness and bucket them by bug class + top stack frames
+# usage: ./triage_crashes.sh [crash-triage flags, e.g. -j 8 -t 5000 -f 5 -o DIR]
+#
+# Inputs are replayed with the HARNESS_* settings their campaign ran with: the
+# nearest harness.env above a crashes/ dir (run_campaign_linux.sh writes one),
+# else this shell's HARNESS_* variables. A run started by hand, e.g. with
+# HARNESS_PROGRESSIVE=1, needs the same variables here or its crashes are
+# replayed down the default path and show up as "did not reproduce"
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${SCRIPT_DIR}/build"
+TRIAGE="${BUILD_DIR}/crash-triage"
+
+echo "===== Crash Triage ====="
+
+if [ ! -x "${TRIAGE}" ]; then
+    echo "ERROR: ${TRIAGE} not found. Please run build_linux.sh first."
+    exit 1
+fi
+
+# -o is resolved here, the other flags go to crash-triage as given
+OUT_DIR="${BUILD_DIR}/triage"
+TRIAGE_ARGS=()
+while getopts "j:t:f:o:" opt; do
+    case $opt in
+        o) OUT_DIR=$OPTARG ;;
+        \?) exit 1 ;;
+        *) TRIAGE_ARGS+=("-${opt}" "$OPTARG") ;;
+    esac
+done
+
+# stack frames are only symbolized when ASAN can find llvm-symbolizer
+if [ -z "${ASAN_SYMBOLIZER_PATH}" ] && command -v llvm-symbolizer &> /dev/null; then
+    export ASAN_SYMBOLIZER_PATH="$(command -v llvm-symbolizer)"
+fi
+
+# default/crashes of single runs, main/ and sec*/ of campaigns, scale-N/ of scaling runs
+DIRS=()
+while IFS= read -r dir; do
+    DIRS+=("$dir")
+done < <(find "${BUILD_DIR}"/output-* -maxdepth 3 -type d \( -name crashes -o -name hangs \) 2>/dev/null | sort)
+
+if [ ${#DIRS[@]} -eq 0 ]; then
+    echo "No crashes/ or hangs/ directories under ${BUILD_DIR}/output-*"
+    exit 0
+fi
+
+# HARNESS_* lines a directory was fuzzed with, sorted so equal configs compare equal
+harness_env() {
+    local dir=$1
+    while [ "$dir" != "${BUILD_DIR}" ] && [ "$dir" != / ]; do
+        if [ -f "${dir}/harness.env" ]; then
+            grep '^HARNESS_' "${dir}/harness.env" | sort || true
+            return
+        fi
+        dir=$(dirname "$dir")
+    done
+    env | grep '^HARNESS_' | sort || true
+}
+
+# group directories by config; one crash-triage run per group
+declare -A GROUP_DIRS=()
+CONFIGS=()
+for dir in "${DIRS[@]}"; do
+    config=$(harness_env "$dir")
+    if [ -z "${GROUP_DIRS[x${config}]+set}" ]; then
+        CONFIGS+=("$config")
+        GROUP_DIRS[x${config}]=""
+    fi
+    GROUP_DIRS[x${config}]+="${dir}"$'\n'
+done
+
+# replay one group with exactly its HARNESS_* settings
+run_group() {
+    local config=$1
+    local out=$2
+    local env_args=() dirs=() var line
+    for var in $(compgen -e | grep '^HARNESS_' || true); do
+        env_args+=(-u "$var")
+    done
+    while IFS= read -r line; do
+        [ -n "$line" ] && env_args+=("$line")
+    done <<< "$config"
+    while IFS= read -r line; do
+        [ -n "$line" ] && dirs+=("$line")
+    done <<< "${GROUP_DIRS[x${config}]}"
+
+    local shown=${config//$'\n'/ }
+    echo "Replaying ${#dirs[@]} directories with: ${shown:-default harness settings}"
+    env "${env_args[@]}" "${TRIAGE}" -o "$out" "${TRIAGE_ARGS[@]}" "${dirs[@]}"
+}
+
+if [ ${#CONFIGS[@]} -eq 1 ]; then
+    run_group "${CONFIGS[0]}" "${OUT_DIR}"
+    exit 0
+fi
+
+# several configs: one result set each, and a triage.md that strings them together
+mkdir -p "${OUT_DIR}"
+: > "${OUT_DIR}/triage.md"
+for i in "${!CONFIGS[@]}"; do
+    run_group "${CONFIGS[i]}" "${OUT_DIR}/config-$((i + 1))"
+    echo ""
+    sed "1s|.*|# Crash triage, config-$((i + 1))|" "${OUT_DIR}/config-$((i + 1))/triage.md" \
+        >> "${OUT_DIR}/triage.md"
+    echo "" >> "${OUT_DIR}/triage.md"
+done
+echo "Per-config results: ${OUT_DIR}/config-*/, combined report: ${OUT_DIR}/triage.md"